@@ -0,0 +1,587 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "types.h"
+#include "tokenizer.h"
+
+/**
+ * Micro-benchmark of the tokenizer engines.
+ *
+ * Each corpus is tokenized line by line with each engine. The corpus is
+ * copied afresh before every run since unquoting is done in place, and the
+ * copy is not timed. After a warmup run, the fastest of the runs is reported
+ * in ns/byte and tokens/sec; it is the least disturbed by the other load.
+ * Allocations are counted by wrapping malloc() and realloc() at link time
+ * (see Makefile).
+ *
+ * The drift from a baseline is only reported by default, since a baseline
+ * recorded on another machine does not tell much. It fails the run with -s
+ * when the baseline is of the same host.
+ */
+
+#define CORPUS_SIZE		(8 << 20)
+#define NR_RUNS			5
+#define DRIFT_PERCENT	20	/* Flag the results slower than this */
+#define MAX_SPANS		1024
+
+/***********************************************************************
+ * Allocation counter
+ */
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static unsigned long __nr_allocs = 0;
+
+void *__wrap_malloc(size_t size)
+{
+	__nr_allocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	__nr_allocs++;
+	return __real_realloc(ptr, size);
+}
+
+
+/***********************************************************************
+ * Corpus generators
+ */
+struct corpus {
+	const char *name;
+	char *data;
+	size_t len;
+};
+
+static unsigned int __seed = 2020;
+
+static unsigned int __rand(void)
+{
+	__seed = __seed * 1103515245 + 12345;
+	return (__seed >> 16) & 0x7fff;
+}
+
+static const char *__words[] = {
+	"ls", "-al", "cd", "..", "/home/sce213", "cp", "-pr", "./toy", "sleep",
+	"echo", "hello", "world", "timeout", "for", "tar", "czf", "pa1.c",
+	"Makefile", "/usr/bin/env", "grep", "-n", "parse_command",
+};
+#define NR_WORDS	(sizeof(__words) / sizeof(__words[0]))
+
+static void __put(struct corpus *c, const char *s, size_t len)
+{
+	if (c->len + len > CORPUS_SIZE) len = CORPUS_SIZE - c->len;
+	memcpy(c->data + c->len, s, len);
+	c->len += len;
+}
+
+static void __puts(struct corpus *c, const char *s)
+{
+	__put(c, s, strlen(s));
+}
+
+/* Short shell commands as typed into mysh */
+static void gen_short_commands(struct corpus *c)
+{
+	while (c->len < CORPUS_SIZE - 256) {
+		int nr = 1 + __rand() % 5;
+
+		for (int i = 0; i < nr; i++) {
+			if (i) __puts(c, " ");
+			__puts(c, __words[__rand() % NR_WORDS]);
+		}
+		__puts(c, "\n");
+	}
+}
+
+/* Long lines with many quoted strings */
+static void gen_long_quoted(struct corpus *c)
+{
+	while (c->len < CORPUS_SIZE - 8192) {
+		int nr = 100 + __rand() % 100;
+
+		__puts(c, "echo");
+		for (int i = 0; i < nr; i++) {
+			__puts(c, __rand() % 2 ? " \"" : " ");
+			__puts(c, __words[__rand() % NR_WORDS]);
+			__puts(c, " ");
+			__puts(c, __words[__rand() % NR_WORDS]);
+			__puts(c, "\"");
+		}
+		__puts(c, "\n");
+	}
+}
+
+/* Many single-character tokens */
+static void gen_tiny_tokens(struct corpus *c)
+{
+	while (c->len < CORPUS_SIZE - 256) {
+		for (int i = 0; i < 60; i++) {
+			char token[2] = { 'a' + __rand() % 26, ' ' };
+			__put(c, token, 2);
+		}
+		__puts(c, "\n");
+	}
+}
+
+/* Long runs of mixed whitespaces between tokens */
+static void gen_whitespace_runs(struct corpus *c)
+{
+	static const char spaces[] = " \t\v\f\r";
+
+	while (c->len < CORPUS_SIZE - 4096) {
+		for (int i = 0; i < 8; i++) {
+			int run = __rand() % 256;
+
+			for (int j = 0; j < run; j++) {
+				__put(c, spaces + __rand() % 5, 1);
+			}
+			__puts(c, __words[__rand() % NR_WORDS]);
+		}
+		__puts(c, "\n");
+	}
+}
+
+/**
+ * The process scripts of the scheduler simulator, repeated. The Makefile
+ * points SCHED_TESTCASES at them in the source tree, so the benchmark runs
+ * from anywhere.
+ */
+#ifndef SCHED_TESTCASES
+#define SCHED_TESTCASES	"../osproject2-master/testcases"
+#endif
+
+static const char *__sched_scripts[] = {
+	SCHED_TESTCASES "/multi",
+	SCHED_TESTCASES "/prio",
+	SCHED_TESTCASES "/resources-adv1",
+	SCHED_TESTCASES "/resources-adv2",
+	SCHED_TESTCASES "/resources-basic",
+	SCHED_TESTCASES "/single",
+};
+
+static void gen_sched_scripts(struct corpus *c)
+{
+	char *scripts = malloc(1 << 16);
+	size_t len = 0;
+
+	for (int i = 0; i < sizeof(__sched_scripts) / sizeof(__sched_scripts[0]); i++) {
+		FILE *f = fopen(__sched_scripts[i], "r");
+
+		if (!f) continue;
+		len += fread(scripts + len, 1, (1 << 16) - len, f);
+		fclose(f);
+	}
+
+	if (len) {
+		while (c->len < CORPUS_SIZE - len) __put(c, scripts, len);
+	}
+	free(scripts);
+}
+
+static struct {
+	const char *name;
+	void (*generate)(struct corpus *c);
+} __generators[] = {
+	{ "short", gen_short_commands },
+	{ "quoted", gen_long_quoted },
+	{ "tiny", gen_tiny_tokens },
+	{ "spaces", gen_whitespace_runs },
+	{ "sched", gen_sched_scripts },
+};
+#define NR_CORPORA	(sizeof(__generators) / sizeof(__generators[0]))
+
+
+/***********************************************************************
+ * Tokenizers under test
+ */
+
+#define LEGACY_TOKEN_LEN	64	/* MAX_TOKEN_LEN of pa0.c */
+
+/**
+ * The loop of pa0.c before it was moved onto libtoken; a buffer is malloc()ed
+ * for each token, and the characters are copied into it. Kept here as the
+ * reference point, with the bounds and the free() it missed.
+ */
+static unsigned long legacy_tokenize(char *data, size_t len, unsigned int flags)
+{
+	char *tokens[MAX_SPANS];
+	unsigned long nr_tokens = 0;
+	char *curr = data, *end = data + len;
+
+	while (curr < end) {
+		char *token = malloc(LEGACY_TOKEN_LEN);
+		int nr = 0, j = 0;
+
+		while (curr < end && *curr != '\n') {
+			if (isspace(*curr)) {
+				if (j) {
+					token[j] = '\0';
+					if (nr < MAX_SPANS) tokens[nr++] = token;
+					else free(token);
+					j = 0;
+					token = malloc(LEGACY_TOKEN_LEN);
+				}
+			} else if (*curr == '"') {
+				while (++curr < end && *curr != '"' && *curr != '\n') {
+					if (j < LEGACY_TOKEN_LEN - 1) token[j++] = *curr;
+				}
+				if (curr == end || *curr == '\n') break;
+			} else if (j < LEGACY_TOKEN_LEN - 1) {
+				token[j++] = *curr;
+			}
+			curr++;
+		}
+		curr++;
+
+		if (j && nr < MAX_SPANS) {
+			token[j] = '\0';
+			tokens[nr++] = token;
+		} else {
+			free(token);
+		}
+		nr_tokens += nr;
+		for (int i = 0; i < nr; i++) free(tokens[i]);
+	}
+	return nr_tokens;
+}
+
+/**
+ * The loop of parser.c in pa1 and pa2 before they were moved onto libtoken
+ */
+static unsigned long parser_tokenize(char *data, size_t len, unsigned int flags)
+{
+	char *tokens[MAX_SPANS];
+	unsigned long nr_tokens = 0;
+	char *curr = data, *end = data + len;
+
+	while (curr < end) {
+		int nr = 0;
+		bool token_started = false;
+
+		while (curr < end && *curr != '\n') {
+			if (isspace(*curr)) {
+				*curr = '\0';
+				token_started = false;
+			} else if (!token_started) {
+				if (nr < MAX_SPANS) tokens[nr++] = curr;
+				token_started = true;
+			}
+			curr++;
+		}
+		curr++;
+		nr_tokens += nr;
+	}
+	return nr_tokens;
+}
+
+static unsigned long spans_tokenize(char *data, size_t len, unsigned int flags)
+{
+	struct token_span spans[MAX_SPANS];
+	unsigned long nr_tokens = 0;
+	char *line = data, *end = data + len;
+
+	while (line < end) {
+		char *cursor = line;
+		int nr;
+
+		while ((nr = tok_line_spans(line, &cursor, flags,
+						spans, MAX_SPANS)) == MAX_SPANS) {
+			nr_tokens += nr;
+		}
+		nr_tokens += nr;
+		line = cursor + 1;
+	}
+	return nr_tokens;
+}
+
+static unsigned long __stream_nr_tokens;
+
+static void __stream_token(void *data, char *token, size_t len)
+{
+	__stream_nr_tokens++;
+}
+
+static void __stream_line_end(void *data)
+{
+}
+
+static const struct tok_stream_ops __stream_ops = {
+	.token = __stream_token,
+	.line_end = __stream_line_end,
+};
+
+#define STREAM_CHUNK_SIZE	(64 << 10)
+
+static unsigned long stream_tokenize(char *data, size_t len, unsigned int flags)
+{
+	static char chunk[STREAM_CHUNK_SIZE + 1];
+	struct tok_stream ts;
+
+	__stream_nr_tokens = 0;
+	tok_stream_init(&ts, flags, &__stream_ops, NULL);
+	for (size_t done = 0; done < len; done += STREAM_CHUNK_SIZE) {
+		size_t n = len - done < STREAM_CHUNK_SIZE ? len - done : STREAM_CHUNK_SIZE;
+
+		/* As if read() it into the buffer */
+		memcpy(chunk, data + done, n);
+		tok_stream_feed(&ts, chunk, n);
+	}
+	tok_stream_finish(&ts);
+	tok_stream_fini(&ts);
+
+	return __stream_nr_tokens;
+}
+
+struct tokenizer {
+	const char *name;
+	enum tok_engine engine;
+	unsigned int flags;		/* Passed to @tokenize */
+	unsigned long (*tokenize)(char *data, size_t len, unsigned int flags);
+};
+
+static struct tokenizer __tokenizers[] = {
+	{ "legacy", TOK_ENGINE_AUTO, TOK_QUOTE, legacy_tokenize },
+	{ "parser", TOK_ENGINE_AUTO, 0, parser_tokenize },
+	{ "scalar", TOK_ENGINE_SCALAR, TOK_QUOTE, spans_tokenize },
+	{ "table", TOK_ENGINE_TABLE, TOK_QUOTE, spans_tokenize },
+	{ "sse2", TOK_ENGINE_SSE2, TOK_QUOTE, spans_tokenize },
+	{ "avx2", TOK_ENGINE_AVX2, TOK_QUOTE, spans_tokenize },
+	{ "stream", TOK_ENGINE_AUTO, TOK_QUOTE, stream_tokenize },
+	{ "dfa", TOK_ENGINE_AUTO, TOK_SHELL, spans_tokenize },
+};
+#define NR_TOKENIZERS	(sizeof(__tokenizers) / sizeof(__tokenizers[0]))
+
+
+/***********************************************************************
+ * Baseline
+ *
+ * One result per line: <corpus> <tokenizer> <ns/byte>. Lines starting with
+ * '#' are comments.
+ */
+struct result {
+	char corpus[32];
+	char tokenizer[32];
+	double ns_per_byte;
+};
+
+static struct result __baseline[NR_CORPORA * NR_TOKENIZERS];
+static int __nr_baseline = 0;
+
+static int load_baseline(const char *filename)
+{
+	char line[128];
+	FILE *f = fopen(filename, "r");
+
+	if (!f) return -errno;
+
+	while (fgets(line, sizeof(line), f) &&
+			__nr_baseline < sizeof(__baseline) / sizeof(__baseline[0])) {
+		struct result *r = __baseline + __nr_baseline;
+
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%31s %31s %lf",
+					r->corpus, r->tokenizer, &r->ns_per_byte) == 3) {
+			__nr_baseline++;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+static struct result *find_baseline(const char *corpus, const char *tokenizer)
+{
+	for (int i = 0; i < __nr_baseline; i++) {
+		if (strcmp(__baseline[i].corpus, corpus) == 0 &&
+				strcmp(__baseline[i].tokenizer, tokenizer) == 0) {
+			return __baseline + i;
+		}
+	}
+	return NULL;
+}
+
+
+/***********************************************************************
+ * Benchmark driver
+ */
+static double __now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int __compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static unsigned long __count_lines(const char *data, size_t len)
+{
+	unsigned long nr = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (data[i] == '\n') nr++;
+	}
+	return nr ? nr : 1;
+}
+
+static void __print_usage(char * const name)
+{
+	printf("Usage: %s [-r runs] [-b baseline [-s]] [-w baseline]\n", name);
+	printf("\n");
+	printf("  -r: Number of timed runs (%d by default)\n", NR_RUNS);
+	printf("  -b: Compare against the baseline file\n");
+	printf("  -s: Fail if a result drifted more than %d%%\n", DRIFT_PERCENT);
+	printf("  -w: Write the results into the baseline file\n");
+	printf("\n");
+}
+
+int main(int argc, char * const argv[])
+{
+	int nr_runs = NR_RUNS;
+	const char *baseline = NULL;
+	FILE *output = NULL;
+	int nr_drifts = 0;
+	bool strict = false;
+	int opt;
+	char *work;
+
+	while ((opt = getopt(argc, argv, "r:b:sw:h")) != -1) {
+		switch (opt) {
+		case 'r':
+			nr_runs = atoi(optarg);
+			if (nr_runs <= 0) nr_runs = 1;
+			break;
+		case 'b':
+			baseline = optarg;
+			break;
+		case 's':
+			strict = true;
+			break;
+		case 'w':
+			output = fopen(optarg, "w");
+			if (!output) {
+				fprintf(stderr, "Cannot write %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'h':
+		default:
+			__print_usage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if (baseline && load_baseline(baseline)) {
+		fprintf(stderr, "No baseline %s; skip the comparison\n", baseline);
+	}
+	if (output) {
+		fprintf(output, "# <corpus> <tokenizer> <ns/byte>\n");
+	}
+
+	work = malloc(CORPUS_SIZE + 1);
+
+	printf("%-8s %-8s %10s %14s %12s %8s\n",
+			"corpus", "engine", "ns/byte", "tokens/sec", "allocs/line", "drift");
+
+	for (int i = 0; i < NR_CORPORA; i++) {
+		struct corpus c = {
+			.name = __generators[i].name,
+			.data = malloc(CORPUS_SIZE + 1),
+		};
+		unsigned long nr_lines;
+
+		__generators[i].generate(&c);
+		if (c.len == 0) {
+			fprintf(stderr, "Skip empty corpus %s\n", c.name);
+			free(c.data);
+			continue;
+		}
+		nr_lines = __count_lines(c.data, c.len);
+
+		for (int j = 0; j < NR_TOKENIZERS; j++) {
+			struct tokenizer *t = __tokenizers + j;
+			struct result *base;
+			double elapsed[nr_runs];
+			unsigned long nr_tokens = 0, nr_allocs = 0;
+			double ns_per_byte;
+			char drift[16] = "-";
+
+			if (tok_set_engine(t->engine)) continue;	/* Not supported */
+
+			for (int run = -1; run < nr_runs; run++) {	/* -1 for warmup */
+				unsigned long allocs;
+				double start;
+
+				memcpy(work, c.data, c.len);
+				work[c.len] = '\0';
+
+				allocs = __nr_allocs;
+				start = __now_ns();
+				nr_tokens = t->tokenize(work, c.len, t->flags);
+				if (run < 0) continue;
+
+				elapsed[run] = __now_ns() - start;
+				nr_allocs += __nr_allocs - allocs;
+			}
+
+			qsort(elapsed, nr_runs, sizeof(double), __compare_double);
+			ns_per_byte = elapsed[0] / c.len;
+
+			base = find_baseline(c.name, t->name);
+			if (base) {
+				double change = (ns_per_byte / base->ns_per_byte - 1) * 100;
+
+				snprintf(drift, sizeof(drift), "%+.0f%%%s",
+						change, change > DRIFT_PERCENT ? " !" : "");
+				if (change > DRIFT_PERCENT) nr_drifts++;
+			}
+
+			printf("%-8s %-8s %10.3f %14.0f %12.4f %8s\n",
+					c.name, t->name, ns_per_byte,
+					nr_tokens / (elapsed[0] / 1e9),
+					(double)nr_allocs / nr_runs / nr_lines, drift);
+
+			if (output) {
+				fprintf(output, "%s %s %.4f\n", c.name, t->name, ns_per_byte);
+			}
+		}
+		free(c.data);
+	}
+
+	tok_set_engine(TOK_ENGINE_AUTO);
+	free(work);
+	if (output) fclose(output);
+
+	if (nr_drifts) {
+		printf("\n%d result%s drifted more than %d%% from the baseline\n",
+				nr_drifts, nr_drifts >= 2 ? "s" : "", DRIFT_PERCENT);
+		if (strict) return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
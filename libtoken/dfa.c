@@ -0,0 +1,85 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stddef.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "scan.h"
+#include "dfa.h"
+#include "dfa_tables.h"
+
+/**
+ * Tokenize in the shell rules (TOK_SHELL) with the DFA generated by gen_dfa.
+ *
+ * The loop takes one table lookup per byte. Copying the byte is done without
+ * branching; the byte is always stored at @w, and @w advances only when the
+ * transition says DFA_COPY. @w never passes the byte being read, so the store
+ * never clobbers unread input. Other actions happen at the token boundaries
+ * only.
+ *
+ * While the DFA loops on a state (e.g., in the middle of a word), the inner
+ * loop runs on the row of the state. The lookup then does not depend on the
+ * previous one, so the bytes flow through the pipeline back to back.
+ */
+int __tok_dfa_line_spans(char *line, char **cursor,
+		struct token_span spans[], int max)
+{
+	unsigned char *p = (unsigned char *)*cursor;
+	unsigned char *start = p, *w = p;
+	unsigned int state = DFA_SPACE;
+	int nr = 0;
+
+	if (max <= 0) return 0;
+
+	while (true) {
+		const unsigned char *row = __dfa[state];
+		const unsigned char self = __dfa_self[state];
+		const bool copy = self & DFA_COPY;
+		unsigned char c, t;
+
+		if (copy) {
+			while ((t = row[c = *p]) == self) {
+				*w++ = c;
+				p++;
+			}
+		} else {
+			while ((t = row[c = *p]) == self) p++;
+		}
+
+		if (t & (DFA_START | DFA_END | DFA_BACKSLASH | DFA_STOP)) {
+			if (t & DFA_START) {
+				start = w = p;
+			}
+			if (t & DFA_BACKSLASH) {
+				*w++ = '\\';
+			}
+			if (t & DFA_END) {
+				spans[nr].offset = (char *)start - line;
+				spans[nr].len = w - start;
+				if (++nr == max && !(t & DFA_STOP)) break;
+			}
+			if (t & DFA_STOP) break;
+		}
+
+		*w = c;
+		w += (t & DFA_COPY) >> 3;
+		state = t & DFA_STATE_MASK;
+		p++;
+	}
+
+	*cursor = (char *)p;
+	return nr;
+}
@@ -0,0 +1,42 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __DFA_H__
+#define __DFA_H__
+
+/**
+ * States and actions of the DFA tokenizer. Shared by gen_dfa.c, which
+ * generates the transition table, and dfa.c, which runs it.
+ */
+enum dfa_state {
+	DFA_SPACE,		/* Between tokens */
+	DFA_WORD,		/* In a token, out of quotes */
+	DFA_WORD_ESC,	/* After a backslash out of quotes */
+	DFA_DQ,			/* In "..." */
+	DFA_DQ_ESC,		/* After a backslash in "..." */
+	DFA_SQ,			/* In '...' */
+	DFA_COMMENT,	/* After # */
+	NR_DFA_STATES,
+};
+
+#define DFA_STATE_MASK	0x07
+
+#define DFA_COPY		0x08	/* Put the byte into the token */
+#define DFA_START		0x10	/* A token starts at the byte */
+#define DFA_END			0x20	/* The token ends before the byte */
+#define DFA_BACKSLASH	0x40	/* Put a backslash before the byte */
+#define DFA_STOP		0x80	/* The end of line */
+
+#endif
@@ -0,0 +1,153 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+
+/**
+ * Generate the tables of the DFA tokenizer in dfa.c at build time.
+ *
+ * The DFA follows the shell rules; whitespaces split tokens, "..." and '...'
+ * quote whitespaces, a backslash escapes the next character (in "...", only
+ * '"' and '\'; others keep the backslash), and '#' at the beginning of a
+ * token comments out the rest of the line. Every state ends at '\n' and '\0',
+ * closing any open quote, so malformed input never runs past the line.
+ *
+ * Each entry of __dfa[state][byte] packs the next state in the low bits and
+ * the actions to take on the byte in the high bits. See dfa.h.
+ * __dfa_self[state] is the entry that loops on the state without any action
+ * other than DFA_COPY, or 0xff if there is no such entry.
+ */
+
+#include "dfa.h"
+
+enum char_class {
+	CC_OTHER,
+	CC_SPACE,
+	CC_EOL,
+	CC_DQUOTE,
+	CC_SQUOTE,
+	CC_BACKSLASH,
+	CC_HASH,
+	NR_CHAR_CLASSES,
+};
+
+static const char * const __state_names[NR_DFA_STATES] = {
+	"DFA_SPACE", "DFA_WORD", "DFA_WORD_ESC", "DFA_DQ", "DFA_DQ_ESC",
+	"DFA_SQ", "DFA_COMMENT",
+};
+
+static enum char_class classify(int c)
+{
+	switch (c) {
+	case ' ': case '\t': case '\v': case '\f': case '\r':
+		return CC_SPACE;
+	case '\n': case '\0':
+		return CC_EOL;
+	case '"':
+		return CC_DQUOTE;
+	case '\'':
+		return CC_SQUOTE;
+	case '\\':
+		return CC_BACKSLASH;
+	case '#':
+		return CC_HASH;
+	default:
+		return CC_OTHER;
+	}
+}
+
+static unsigned char transition(int state, enum char_class cc)
+{
+	/* The end of line ends the token, if any, in every state */
+	if (cc == CC_EOL) {
+		if (state == DFA_SPACE || state == DFA_COMMENT) return DFA_STOP;
+		return DFA_END | DFA_STOP;
+	}
+
+	switch (state) {
+	case DFA_SPACE:
+		switch (cc) {
+		case CC_SPACE:		return DFA_SPACE;
+		case CC_HASH:		return DFA_COMMENT;
+		case CC_DQUOTE:		return DFA_START | DFA_DQ;
+		case CC_SQUOTE:		return DFA_START | DFA_SQ;
+		case CC_BACKSLASH:	return DFA_START | DFA_WORD_ESC;
+		default:			return DFA_START | DFA_COPY | DFA_WORD;
+		}
+	case DFA_WORD:
+		switch (cc) {
+		case CC_SPACE:		return DFA_END | DFA_SPACE;
+		case CC_DQUOTE:		return DFA_DQ;
+		case CC_SQUOTE:		return DFA_SQ;
+		case CC_BACKSLASH:	return DFA_WORD_ESC;
+		default:			return DFA_COPY | DFA_WORD;
+		}
+	case DFA_WORD_ESC:
+		return DFA_COPY | DFA_WORD;
+	case DFA_DQ:
+		switch (cc) {
+		case CC_DQUOTE:		return DFA_WORD;
+		case CC_BACKSLASH:	return DFA_DQ_ESC;
+		default:			return DFA_COPY | DFA_DQ;
+		}
+	case DFA_DQ_ESC:
+		switch (cc) {
+		case CC_DQUOTE:
+		case CC_BACKSLASH:	return DFA_COPY | DFA_DQ;
+		default:			return DFA_BACKSLASH | DFA_COPY | DFA_DQ;
+		}
+	case DFA_SQ:
+		switch (cc) {
+		case CC_SQUOTE:		return DFA_WORD;
+		default:			return DFA_COPY | DFA_SQ;
+		}
+	case DFA_COMMENT:
+	default:
+		return DFA_COMMENT;
+	}
+}
+
+int main(void)
+{
+	printf("/* Generated by gen_dfa. DO NOT EDIT */\n\n");
+	printf("static const unsigned char __dfa[NR_DFA_STATES][256] = {\n");
+
+	for (int state = 0; state < NR_DFA_STATES; state++) {
+		printf("\t[%s] = {", __state_names[state]);
+		for (int c = 0; c < 256; c++) {
+			if (c % 16 == 0) printf("\n\t\t");
+			printf("0x%02x,%s", transition(state, classify(c)),
+					c % 16 == 15 ? "" : " ");
+		}
+		printf("\n\t},\n");
+	}
+	printf("};\n\n");
+
+	printf("static const unsigned char __dfa_self[NR_DFA_STATES] = {\n");
+	for (int state = 0; state < NR_DFA_STATES; state++) {
+		unsigned char t = 0xff;
+
+		for (int cc = 0; cc < NR_CHAR_CLASSES; cc++) {
+			if ((transition(state, cc) & ~DFA_COPY) == state) {
+				t = transition(state, cc);
+				break;
+			}
+		}
+		printf("\t[%s] = 0x%02x,\n", __state_names[state], t);
+	}
+	printf("};\n");
+
+	return 0;
+}
@@ -0,0 +1,200 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "types.h"
+#include "tokenizer.h"
+
+#define INTERN_INITIAL_SLOTS	256		/* Should be a power of 2 */
+#define INTERN_BLOCK_SIZE		(64 << 10)
+
+/**
+ * Atoms are allocated from blocks chained through the first word, so that
+ * they never move and interning a new token does not call malloc() mostly.
+ */
+struct intern_block {
+	struct intern_block *prev;
+	char data[];
+};
+
+unsigned int tok_hash(const char *token, size_t len)
+{
+	/* 32-bit FNV-1a */
+	unsigned int hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)token[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+int tok_intern_init(struct tok_intern *ti)
+{
+	*ti = (struct tok_intern) {
+		.nr_slots = INTERN_INITIAL_SLOTS,
+	};
+
+	ti->slots = calloc(ti->nr_slots, sizeof(*ti->slots));
+	if (!ti->slots) return -ENOMEM;
+	return 0;
+}
+
+void tok_intern_fini(struct tok_intern *ti)
+{
+	struct intern_block *b = ti->block;
+
+	while (b) {
+		struct intern_block *prev = b->prev;
+		free(b);
+		b = prev;
+	}
+	free(ti->slots);
+	free(ti->atoms);
+	*ti = (struct tok_intern) { 0 };
+}
+
+static inline bool __atom_match(const struct tok_atom *a, const char *token,
+		size_t len, unsigned int hash)
+{
+	return a->hash == hash && a->len == len && memcmp(a->str, token, len) == 0;
+}
+
+static struct tok_atom **__find_slot(struct tok_intern *ti, const char *token,
+		size_t len, unsigned int hash)
+{
+	unsigned int mask = ti->nr_slots - 1;
+
+	for (unsigned int i = hash & mask; ; i = (i + 1) & mask) {
+		struct tok_atom **slot = ti->slots + i;
+
+		if (!*slot || __atom_match(*slot, token, len, hash)) return slot;
+	}
+}
+
+static int __grow_slots(struct tok_intern *ti)
+{
+	struct tok_atom **old = ti->slots;
+	unsigned int nr_old = ti->nr_slots;
+
+	ti->slots = calloc(nr_old * 2, sizeof(*ti->slots));
+	if (!ti->slots) {
+		ti->slots = old;
+		return -ENOMEM;
+	}
+	ti->nr_slots = nr_old * 2;
+
+	for (unsigned int i = 0; i < nr_old; i++) {
+		if (!old[i]) continue;
+		*__find_slot(ti, old[i]->str, old[i]->len, old[i]->hash) = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+static struct tok_atom *__new_atom(struct tok_intern *ti, const char *token,
+		size_t len, unsigned int hash)
+{
+	size_t size = sizeof(struct tok_atom) + len + 1;
+	struct tok_atom *a;
+
+	/* Keep the atoms aligned for the integer fields */
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+	if (!ti->block || ti->block_used + size > ti->block_size) {
+		size_t block_size = INTERN_BLOCK_SIZE;
+		struct intern_block *b;
+
+		if (size > block_size) block_size = size;
+		b = malloc(sizeof(*b) + block_size);
+		if (!b) return NULL;
+
+		b->prev = ti->block;
+		ti->block = b;
+		ti->block_used = 0;
+		ti->block_size = block_size;
+	}
+
+	if (ti->nr_atoms == ti->max_atoms) {
+		unsigned int max = ti->max_atoms ? ti->max_atoms * 2 : INTERN_INITIAL_SLOTS;
+		const struct tok_atom **atoms = realloc(ti->atoms, sizeof(*atoms) * max);
+
+		if (!atoms) return NULL;
+		ti->atoms = atoms;
+		ti->max_atoms = max;
+	}
+
+	a = (struct tok_atom *)(ti->block->data + ti->block_used);
+	ti->block_used += size;
+
+	a->id = ti->nr_atoms;
+	a->hash = hash;
+	a->len = len;
+	memcpy(a->str, token, len);
+	a->str[len] = '\0';
+
+	ti->atoms[ti->nr_atoms++] = a;
+	ti->nr_bytes += len;
+	return a;
+}
+
+const struct tok_atom *tok_intern_hashed(struct tok_intern *ti,
+		const char *token, size_t len, unsigned int hash)
+{
+	struct tok_atom **slot;
+
+	ti->nr_lookups++;
+
+	slot = __find_slot(ti, token, len, hash);
+	if (*slot) {
+		ti->nr_hits++;
+		return *slot;
+	}
+
+	/* Keep the load factor under 3/4 so that probing stays short */
+	if ((ti->nr_atoms + 1) * 4 > ti->nr_slots * 3) {
+		if (__grow_slots(ti)) return NULL;
+		slot = __find_slot(ti, token, len, hash);
+	}
+
+	*slot = __new_atom(ti, token, len, hash);
+	return *slot;
+}
+
+const struct tok_atom *tok_intern(struct tok_intern *ti,
+		const char *token, size_t len)
+{
+	return tok_intern_hashed(ti, token, len, tok_hash(token, len));
+}
+
+const struct tok_atom *tok_intern_find(struct tok_intern *ti,
+		const char *token, size_t len)
+{
+	struct tok_atom **slot;
+
+	ti->nr_lookups++;
+
+	slot = __find_slot(ti, token, len, tok_hash(token, len));
+	if (*slot) ti->nr_hits++;
+	return *slot;
+}
+
+const struct tok_atom *tok_intern_atom(struct tok_intern *ti, unsigned int id)
+{
+	return id < ti->nr_atoms ? ti->atoms[id] : NULL;
+}
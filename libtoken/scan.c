@@ -0,0 +1,256 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "scan.h"
+
+/**
+ * Whitespace in the C locale (i.e., isspace()); ' ', '\t', '\n', '\v', '\f',
+ * and '\r'. The users never call setlocale(), so this is exactly what
+ * isspace() says.
+ */
+static inline bool is_space(char c)
+{
+	return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static inline bool is_eol(char c)
+{
+	return c == '\n' || c == '\0';
+}
+
+static char *scan_scalar(char *p, enum scan_mode mode)
+{
+	switch (mode) {
+	case SCAN_NONSPACE:
+		while (*p != '\n' && is_space(*p)) p++;
+		break;
+	case SCAN_DELIM:
+		while (*p != '\0' && *p != '"' && !is_space(*p)) p++;
+		break;
+	case SCAN_QUOTE:
+		while (!is_eol(*p) && *p != '"') p++;
+		break;
+	case SCAN_EOL:
+	default:
+		while (!is_eol(*p)) p++;
+		break;
+	}
+	return p;
+}
+
+
+/**
+ * Table-driven engine. Each byte is classified with one lookup, and the scan
+ * stops at the classes of the mode.
+ */
+#define C_SPACE	0x01
+#define C_QUOTE	0x02
+#define C_EOL	0x04
+
+static const unsigned char __class[256] = {
+	['\0'] = C_EOL,
+	['\n'] = C_EOL,
+	['\t'] = C_SPACE,
+	['\v'] = C_SPACE,
+	['\f'] = C_SPACE,
+	['\r'] = C_SPACE,
+	[' '] = C_SPACE,
+	['"'] = C_QUOTE,
+};
+
+static const unsigned char __stop[NR_SCAN_MODES] = {
+	[SCAN_DELIM] = C_SPACE | C_QUOTE | C_EOL,
+	[SCAN_QUOTE] = C_QUOTE | C_EOL,
+	[SCAN_EOL] = C_EOL,
+};
+
+static char *scan_table(char *p, enum scan_mode mode)
+{
+	const unsigned char *c = (const unsigned char *)p;
+
+	if (mode == SCAN_NONSPACE) {
+		while (__class[*c] & C_SPACE) c++;
+	} else {
+		unsigned char stop = __stop[mode];
+
+		while (!(__class[*c] & stop)) c++;
+	}
+	return (char *)c;
+}
+
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_SIMD
+
+/**
+ * The vector engines load aligned blocks only. An aligned block never crosses
+ * a page boundary, so reading the bytes past the end of line of @p is safe
+ * even at the end of a mapping. The bits for the bytes before @p in the first
+ * block are shifted out.
+ */
+static inline unsigned int __scan_mask(unsigned int space, unsigned int quote,
+		unsigned int eol, enum scan_mode mode)
+{
+	switch (mode) {
+	case SCAN_NONSPACE:
+		return ~space | eol;
+	case SCAN_DELIM:
+		return space | quote | eol;
+	case SCAN_QUOTE:
+		return quote | eol;
+	case SCAN_EOL:
+	default:
+		return eol;
+	}
+}
+
+__attribute__((target("sse2")))
+static char *scan_sse2(char *p, enum scan_mode mode)
+{
+	const __m128i *b = (const __m128i *)((unsigned long)p & ~15UL);
+	unsigned int skip = (unsigned long)p & 15;
+	unsigned int mask;
+
+	for (;; b++, skip = 0) {
+		__m128i v = _mm_load_si128(b);
+		/* '\t' .. '\r' become -128 .. -124 after adding 119 */
+		__m128i ctrl = _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(119)),
+				_mm_set1_epi8(-123));
+		__m128i space = _mm_or_si128(ctrl,
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+
+		mask = __scan_mask(
+				_mm_movemask_epi8(space),
+				_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))),
+				_mm_movemask_epi8(_mm_or_si128(
+						_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')))),
+				mode) & (0xffffu << skip) & 0xffffu;
+		if (mask) break;
+	}
+	return (char *)b + __builtin_ctz(mask);
+}
+
+__attribute__((target("avx2")))
+static char *scan_avx2(char *p, enum scan_mode mode)
+{
+	const __m256i *b = (const __m256i *)((unsigned long)p & ~31UL);
+	unsigned int skip = (unsigned long)p & 31;
+	unsigned int mask;
+
+	for (;; b++, skip = 0) {
+		__m256i v = _mm256_load_si256(b);
+		__m256i ctrl = _mm256_cmpgt_epi8(_mm256_set1_epi8(-123),
+				_mm256_add_epi8(v, _mm256_set1_epi8(119)));
+		__m256i space = _mm256_or_si256(ctrl,
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+
+		mask = __scan_mask(
+				_mm256_movemask_epi8(space),
+				_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))),
+				_mm256_movemask_epi8(_mm256_or_si256(
+						_mm256_cmpeq_epi8(v, _mm256_setzero_si256()),
+						_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))),
+				mode) & (0xffffffffu << skip);
+		if (mask) break;
+	}
+	return (char *)b + __builtin_ctz(mask);
+}
+#endif
+
+
+/***********************************************************************
+ * Engine selection
+ */
+static const char * const __engine_names[NR_TOK_ENGINES] = {
+	[TOK_ENGINE_AUTO] = "auto",
+	[TOK_ENGINE_SCALAR] = "scalar",
+	[TOK_ENGINE_TABLE] = "table",
+	[TOK_ENGINE_SSE2] = "sse2",
+	[TOK_ENGINE_AVX2] = "avx2",
+};
+
+char *(*__tok_scan)(char *p, enum scan_mode mode) = scan_scalar;
+static enum tok_engine __engine = TOK_ENGINE_SCALAR;
+
+const char *tok_engine_name(enum tok_engine engine)
+{
+	if (engine < 0 || engine >= NR_TOK_ENGINES) return "unknown";
+	return __engine_names[engine];
+}
+
+enum tok_engine tok_get_engine(void)
+{
+	return __engine;
+}
+
+int tok_set_engine(enum tok_engine engine)
+{
+	switch (engine) {
+	case TOK_ENGINE_AUTO:
+		/**
+		 * The vectors pay off only over long runs of a class, and the
+		 * command lines are mostly short words. See bench.baseline.
+		 */
+		return tok_set_engine(TOK_ENGINE_TABLE);
+	case TOK_ENGINE_SCALAR:
+		__tok_scan = scan_scalar;
+		break;
+	case TOK_ENGINE_TABLE:
+		__tok_scan = scan_table;
+		break;
+#ifdef HAVE_SIMD
+	case TOK_ENGINE_SSE2:
+		__tok_scan = scan_sse2;
+		break;
+	case TOK_ENGINE_AVX2:
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("avx2")) return -EINVAL;
+		__tok_scan = scan_avx2;
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+
+	__engine = engine;
+	return 0;
+}
+
+/**
+ * Pick the engine before main() so that threads never race on it
+ */
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void __tok_init(void)
+{
+	const char *name = getenv("TOK_ENGINE");
+
+	if (name) {
+		for (int i = TOK_ENGINE_SCALAR; i < NR_TOK_ENGINES; i++) {
+			if (strcmp(name, __engine_names[i]) == 0 &&
+					tok_set_engine(i) == 0) return;
+		}
+	}
+	tok_set_engine(TOK_ENGINE_AUTO);
+}
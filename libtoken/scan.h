@@ -0,0 +1,64 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+/**
+ * Internals of the tokenizer engines. Not to be included by the users of
+ * the library.
+ */
+
+/**
+ * Classes of characters to stop scanning at. The end of line, either '\n' or
+ * '\0', always stops the scan.
+ */
+enum scan_mode {
+	SCAN_NONSPACE,	/* Skip whitespaces */
+	SCAN_DELIM,		/* Stop at a whitespace or a quotation mark */
+	SCAN_QUOTE,		/* Stop at a quotation mark */
+	SCAN_EOL,		/* Stop at the end of line only */
+	NR_SCAN_MODES,
+};
+
+/**
+ * The scanner of the engine in use
+ */
+extern char *(*__tok_scan)(char *p, enum scan_mode mode);
+
+static inline char *scan(char *p, enum scan_mode mode)
+{
+	return __tok_scan(p, mode);
+}
+
+/**
+ * The DFA tokenizer for TOK_SHELL in dfa.c
+ */
+int __tok_dfa_line_spans(char *line, char **cursor,
+		struct token_span spans[], int max);
+
+/**
+ * Move the run [@from, @to) of a token back to @w when the token has been
+ * shifted by removing the quotation marks.
+ */
+static inline char *copy_run(char *w, char *from, char *to)
+{
+	if (w == from) return w + (to - from);	/* Nothing unquoted yet */
+
+	while (from < to) *w++ = *from++;
+	return w;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stddef.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "scan.h"
+
+int tok_line_spans(char *line, char **cursor, unsigned int flags,
+		struct token_span spans[], int max)
+{
+	char *curr = *cursor;	/* Next character to scan */
+	int nr = 0;
+
+	if (flags & TOK_SHELL) {
+		return __tok_dfa_line_spans(line, cursor, spans, max);
+	}
+
+	while (nr < max) {
+		char *start, *w, *stop;
+
+		curr = scan(curr, SCAN_NONSPACE);
+		if (*curr == '\0' || *curr == '\n') break;
+
+		if ((flags & TOK_COMMENT) && *curr == '#') {
+			curr = scan(curr, SCAN_EOL);
+			break;
+		}
+
+		/**
+		 * Copy the token onto itself run by run. Dropping the quotation marks
+		 * can only shrink the token, so @w never passes @curr.
+		 */
+		start = w = curr;
+		while (true) {
+			stop = scan(curr, SCAN_DELIM);
+			w = copy_run(w, curr, stop);
+			curr = stop;
+			if (*curr != '"') break;	/* Whitespace or the end of line */
+
+			if (!(flags & TOK_QUOTE)) {
+				/* Just a character in the token */
+				w = copy_run(w, curr, curr + 1);
+				curr++;
+				continue;
+			}
+
+			stop = scan(curr + 1, SCAN_QUOTE);
+			w = copy_run(w, curr + 1, stop);
+			curr = stop;
+			if (*curr == '"') curr++;	/* Skip the closing quote if any */
+		}
+
+		/* An empty quote ("") does not make a token */
+		if (w == start) continue;
+
+		spans[nr].offset = start - line;
+		spans[nr].len = w - start;
+		nr++;
+	}
+
+	*cursor = curr;
+	return nr;
+}
+
+int tok_split(char *line, unsigned int flags, char *tokens[], int max)
+{
+	struct token_span spans[max];
+	char *cursor = line;
+	int nr;
+
+	nr = tok_line_spans(line, &cursor, flags, spans, max - 1);
+
+	for (int i = 0; i < nr; i++) {
+		/* The terminator lands at or before the delimiter of the token */
+		tokens[i] = line + spans[i].offset;
+		tokens[i][spans[i].len] = '\0';
+	}
+	tokens[nr] = NULL;
+
+	return nr;
+}
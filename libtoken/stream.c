@@ -0,0 +1,163 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "scan.h"
+
+#define CARRY_INITIAL_SIZE	128
+
+void tok_stream_init(struct tok_stream *ts, unsigned int flags,
+		const struct tok_stream_ops *ops, void *data)
+{
+	*ts = (struct tok_stream) {
+		.ops = ops,
+		.data = data,
+		.flags = flags,
+	};
+}
+
+void tok_stream_fini(struct tok_stream *ts)
+{
+	free(ts->carry);
+	ts->carry = NULL;
+	ts->carry_len = ts->carry_size = 0;
+}
+
+static int __carry(struct tok_stream *ts, char *from, char *to)
+{
+	size_t len = to - from;
+
+	if (ts->carry_len + len > ts->carry_size) {
+		size_t size = ts->carry_size ? ts->carry_size * 2 : CARRY_INITIAL_SIZE;
+		char *carry;
+
+		while (size < ts->carry_len + len) size *= 2;
+		carry = realloc(ts->carry, size);
+		if (!carry) return -ENOMEM;
+		ts->carry = carry;
+		ts->carry_size = size;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		ts->carry[ts->carry_len + i] = from[i];
+	}
+	ts->carry_len += len;
+	return 0;
+}
+
+static int __finish_token(struct tok_stream *ts, char *start, char *end)
+{
+	ts->in_token = ts->in_quote = false;
+
+	if (ts->carry_len) {
+		if (__carry(ts, start, end)) return -ENOMEM;
+		ts->ops->token(ts->data, ts->carry, ts->carry_len);
+		ts->carry_len = 0;
+	} else if (end > start) {
+		/* An empty quote ("") does not make a token */
+		ts->ops->token(ts->data, start, end - start);
+	}
+	return 0;
+}
+
+int tok_stream_feed(struct tok_stream *ts, char *buf, size_t len)
+{
+	char *p = buf, *end = buf + len;
+	char *start = buf, *w = buf;	/* The token being unquoted in @buf */
+
+	if (len == 0) return 0;
+
+	*end = '\0';
+
+	while (true) {
+		char *stop;
+
+		if (ts->in_comment) {
+			p = scan(p, SCAN_EOL);
+			if (p == end) break;
+			ts->in_comment = false;
+		}
+
+		if (!ts->in_token) {
+			p = scan(p, SCAN_NONSPACE);
+			if (p == end) break;
+
+			if (*p == '\n' || *p == '\0') {
+				ts->ops->line_end(ts->data);
+				p++;
+				continue;
+			}
+			if ((ts->flags & TOK_COMMENT) && *p == '#') {
+				ts->in_comment = true;
+				continue;
+			}
+			ts->in_token = true;
+			start = w = p;
+		}
+
+		if (ts->in_quote) {
+			stop = scan(p, SCAN_QUOTE);
+			w = copy_run(w, p, stop);
+			p = stop;
+			if (p == end) break;
+
+			if (*p == '"') {
+				ts->in_quote = false;
+				p++;
+				continue;
+			}
+			/* The end of line closes the quote and the token as well */
+		} else {
+			stop = scan(p, SCAN_DELIM);
+			w = copy_run(w, p, stop);
+			p = stop;
+			if (p == end) break;
+
+			if (*p == '"') {
+				if (ts->flags & TOK_QUOTE) {
+					ts->in_quote = true;
+				} else {
+					w = copy_run(w, p, p + 1);
+				}
+				p++;
+				continue;
+			}
+		}
+
+		/* Leave the delimiter to the !in_token path above */
+		if (__finish_token(ts, start, w)) return -ENOMEM;
+	}
+
+	if (ts->in_token && __carry(ts, start, w)) return -ENOMEM;
+
+	ts->line_open = !(end[-1] == '\n' || end[-1] == '\0');
+	return 0;
+}
+
+int tok_stream_finish(struct tok_stream *ts)
+{
+	if (ts->in_token && __finish_token(ts, NULL, NULL)) return -ENOMEM;
+	ts->in_comment = false;
+
+	if (ts->line_open) {
+		ts->ops->line_end(ts->data);
+		ts->line_open = false;
+	}
+	return 0;
+}
@@ -0,0 +1,220 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __TOKENIZER_H__
+#define __TOKENIZER_H__
+
+#include <stddef.h>
+
+/**
+ * Tokenizer engines shared by pa0, mysh, sched, and vm.
+ *
+ * A token is a run of non-whitespace characters. Whitespace is what isspace()
+ * says in the C locale. A line ends at '\n' or '\0'. Options below add the
+ * quoted strings and comments on top of this.
+ *
+ * TOK_SHELL tokenizes with the table-driven DFA generated at build time (see
+ * gen_dfa.c) instead of the engines, and overrides the other options. Unlike
+ * TOK_QUOTE, an empty quote ("" or '') makes an empty token as the shell does.
+ * The streaming tokenizer does not support TOK_SHELL.
+ *
+ * Tokens are not copied out. Each token is described by its span in the line,
+ * and quoted tokens are unquoted in place. So tokenizing a line does not
+ * allocate any memory.
+ */
+
+#define TOK_QUOTE	0x01	/* "..." quotes whitespaces in a token */
+#define TOK_COMMENT	0x02	/* A token starting with # ends the line */
+#define TOK_SHELL	0x04	/* Shell rules; "...", '...', \ escapes, and # */
+
+/**
+ * Location of a token in the line
+ */
+struct token_span {
+	unsigned int offset;	/* Offset of the first character from the line */
+	unsigned int len;		/* Length of the token without quotation marks */
+};
+
+/**
+ * Engines that classify the characters. They make the same tokens, and
+ * differ in the speed only.
+ */
+enum tok_engine {
+	TOK_ENGINE_AUTO = 0,	/* The fastest one on short lines; the table */
+	TOK_ENGINE_SCALAR,		/* Compare each byte */
+	TOK_ENGINE_TABLE,		/* Look up the class of each byte */
+	TOK_ENGINE_SSE2,		/* Classify 16 bytes at a time */
+	TOK_ENGINE_AVX2,		/* Classify 32 bytes at a time */
+	NR_TOK_ENGINES,
+};
+
+/***********************************************************************
+ * tok_set_engine()
+ *
+ * DESCRIPTION
+ *  Use @engine from now on. The engine is picked automatically when the
+ *  program starts, or from TOK_ENGINE=scalar|table|sse2|avx2 in the
+ *  environment.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -EINVAL if this CPU does not support @engine.
+ */
+int tok_set_engine(enum tok_engine engine);
+enum tok_engine tok_get_engine(void);
+const char *tok_engine_name(enum tok_engine engine);
+
+
+/***********************************************************************
+ * tok_line_spans()
+ *
+ * DESCRIPTION
+ *  Tokenize the line starting at @line from *@cursor, and put the spans of up
+ *  to @max tokens into @spans[]. The offsets are relative to @line. *@cursor
+ *  is left at the end of line ('\n' or '\0'), or right after the last token
+ *  when @spans[] is full so that the next call resumes from there.
+ *
+ * RETURN VALUE
+ *  Return the number of tokens put into @spans[]. The line is done when it is
+ *  less than @max.
+ */
+int tok_line_spans(char *line, char **cursor, unsigned int flags,
+		struct token_span spans[], int max);
+
+
+/***********************************************************************
+ * tok_split()
+ *
+ * DESCRIPTION
+ *  The char * interface of tok_line_spans(). Terminate up to @max - 1 tokens
+ *  in @line with '\0' in place, and put them into @tokens[] followed by NULL.
+ *
+ * RETURN VALUE
+ *  Return the number of tokens.
+ */
+int tok_split(char *line, unsigned int flags, char *tokens[], int max);
+
+
+/***********************************************************************
+ * Streaming tokenizer
+ *
+ * DESCRIPTION
+ *  Tokenize a stream fed in arbitrary chunks, e.g., straight from read().
+ *  Whether a token, a quote, or a comment is open is kept in &struct
+ *  tok_stream across the chunks, so they may span any number of chunks.
+ *
+ *  @ops->token() is called for each token, and @ops->line_end() for each end
+ *  of line. The token passed to @ops->token() is not terminated with '\0',
+ *  and is valid only during the call. Tokens within a chunk point into the
+ *  chunk (unquoted in place); only the tokens spanning chunks are copied.
+ */
+struct tok_stream_ops {
+	void (*token)(void *data, char *token, size_t len);
+	void (*line_end)(void *data);
+};
+
+struct tok_stream {
+	const struct tok_stream_ops *ops;
+	void *data;
+	unsigned int flags;
+
+	int in_token;		/* A token continues to the next chunk */
+	int in_quote;		/* ... in a quoted string */
+	int in_comment;		/* A comment continues to the next chunk */
+	int line_open;		/* Something is fed since the last end of line */
+
+	char *carry;		/* Bytes of the token from the previous chunks */
+	size_t carry_len;
+	size_t carry_size;
+};
+
+void tok_stream_init(struct tok_stream *ts, unsigned int flags,
+		const struct tok_stream_ops *ops, void *data);
+void tok_stream_fini(struct tok_stream *ts);
+
+/**
+ * Feed @len bytes in @buf. @buf should have a room for one more byte after
+ * @len bytes, which is overwritten with '\0' to stop the scanners.
+ *
+ * Return 0 on success, -ENOMEM if a token spanning chunks cannot be kept.
+ */
+int tok_stream_feed(struct tok_stream *ts, char *buf, size_t len);
+
+/**
+ * Flush the last token and line at the end of the stream.
+ */
+int tok_stream_finish(struct tok_stream *ts);
+
+
+/***********************************************************************
+ * Token interning
+ *
+ * DESCRIPTION
+ *  Keep one copy of each distinct token in &struct tok_intern, and hand out
+ *  the same &struct tok_atom for the same bytes. Atoms never move until the
+ *  table is finalized, so repeated tokens can be compared by the pointer or
+ *  by @id instead of strcmp(). IDs are given in the order of interning from
+ *  0, so interning keywords first gives them known IDs.
+ *
+ *  @nr_lookups and @nr_hits count the lookups and the ones that found an
+ *  atom, and @nr_atoms is the number of unique tokens.
+ */
+struct tok_atom {
+	unsigned int id;
+	unsigned int hash;
+	unsigned int len;
+	char str[];			/* Terminated with '\0' */
+};
+
+struct intern_block;
+
+struct tok_intern {
+	struct tok_atom **slots;		/* Open addressing with linear probing */
+	unsigned int nr_slots;
+	const struct tok_atom **atoms;	/* Indexed by the id */
+	unsigned int nr_atoms;
+	unsigned int max_atoms;
+
+	struct intern_block *block;		/* Atoms are allocated from here */
+	size_t block_used;
+	size_t block_size;
+
+	unsigned long nr_lookups;
+	unsigned long nr_hits;
+	unsigned long nr_bytes;			/* Total length of the unique tokens */
+};
+
+int tok_intern_init(struct tok_intern *ti);
+void tok_intern_fini(struct tok_intern *ti);
+
+unsigned int tok_hash(const char *token, size_t len);
+
+/**
+ * Return the atom for @token, interning it if new. tok_intern_hashed() takes
+ * the precomputed tok_hash() of @token. Return NULL when out of memory.
+ */
+const struct tok_atom *tok_intern(struct tok_intern *ti,
+		const char *token, size_t len);
+const struct tok_atom *tok_intern_hashed(struct tok_intern *ti,
+		const char *token, size_t len, unsigned int hash);
+
+/**
+ * Return the atom for @token if interned already, NULL otherwise
+ */
+const struct tok_atom *tok_intern_find(struct tok_intern *ti,
+		const char *token, size_t len);
+
+const struct tok_atom *tok_intern_atom(struct tok_intern *ti, unsigned int id);
+
+#endif
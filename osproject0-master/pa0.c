@@ -25,17 +25,30 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "types.h"
+#include "tokenizer.h"
 
 #define MAX_NR_TOKENS 32    /* Maximum number of tokens in a command */
 #define MAX_TOKEN_LEN 64    /* Maximum length of single token */
 #define MAX_COMMAND    256        /* Maximum length of command string */
 
+/**
+ * Options of the tokenizer. -s takes the shell rules of the DFA tokenizer
+ * instead; '...', \ escapes, and # comments on top of "..." (see tokenizer.h)
+ */
+static unsigned int __tok_flags = TOK_QUOTE;
+
 /***********************************************************************
- * parse_command
+ * parse_command_spans
  *
  * DESCRIPTION
- *    Parse @command, put each command token into @tokens[], and
+ *    Parse @command, put the span of each command token into @spans[], and
  *    set @nr_tokens with the number of tokens.
  *
  * A command token is defined as a string without any whitespace (i.e., *space*
@@ -85,69 +98,720 @@
  *                                                 a, command
  *   "This " is "what I told you" --> This, is, what I told you
  *
+ * parse_command_spans() does not copy the tokens out. Instead, each token is
+ * described by a &struct token_span, that is, the offset from @command and the
+ * length of the token. Quoted tokens are unescaped in place so that each span
+ * covers the token without the quotation marks. Thus, tokenizing a line does
+ * not allocate any memory at all.
+ *
  * RETURN VALUE
- *    Return 0 after filling in @nr_tokens and @tokens[] properly
+ *    Return 0 after filling in @nr_tokens and @spans[] properly
+ *
+ */
+static int parse_command_spans(char *command, int *nr_tokens,
+                               struct token_span spans[])
+{
+    char *cursor = command;
+
+    *nr_tokens = tok_line_spans(command, &cursor, __tok_flags,
+                                spans, MAX_NR_TOKENS);
+    return 0;
+}
+
+
+/***********************************************************************
+ * parse_command
+ *
+ * DESCRIPTION
+ *    Adapter of @parse_command_spans() for the char * interface. Each
+ *    token is terminated with '\0' in place and @tokens[] point into
+ *    @command, so no memory is allocated.
  *
+ * RETURN VALUE
+ *    Return 0 after filling in @nr_tokens and @tokens[] properly
  */
 static int parse_command(char *command, int *nr_tokens, char *tokens[])
 {
-    /**
-     * TODO
-     *
-     * Followings are some example code. Delete them and implement your own
-     * code here
-     */
-    int quatationCnt=0; //*nr_tokens 개수, token의 위치제공
-    char*tempTokens = malloc(sizeof(char)*MAX_TOKEN_LEN);;   //토큰을 임시 저장할 곳
-    int i = 0;  //command 배열 이동
-    int j = 0;  //tempToken 배열 이동
-    
-    while(command[i] != '\0'){
-        if(isspace(command[i])){
-            if(j!=0){
-                tokens[quatationCnt] = tempTokens;
-                quatationCnt = quatationCnt+1;
-                j=0;
-                tempTokens = malloc(sizeof(char)*MAX_TOKEN_LEN);
+    struct token_span spans[MAX_NR_TOKENS];
+
+    parse_command_spans(command, nr_tokens, spans);
+
+    for (int i = 0; i < *nr_tokens; i++) {
+        /* The terminator lands at or before the delimiter of the token */
+        tokens[i] = command + spans[i].offset;
+        tokens[i][spans[i].len] = '\0';
+    }
+    return 0;
+}
+
+
+/***********************************************************************
+ * Batch mode
+ *
+ * DESCRIPTION
+ *    Tokenize a whole file at once. The file is mapped into the memory, so
+ *    lines are not limited by MAX_COMMAND, and the results are written
+ *    through large output buffers instead of fprintf()ing each token.
+ *    Input that cannot be mapped, such as a pipe, is streamed through
+ *    &struct tok_stream instead.
+ *
+ *    In the text format, each line is printed as the default mode does;
+ *
+ *      nr_tokens = <N>
+ *      tokens[<i>] = <token>
+ *      <blank line>
+ *
+ *    In the binary format (-x), each line is the number of tokens followed
+ *    by the tokens. Each token is its length followed by the bytes of the
+ *    token. The numbers are encoded in LEB128 (7 bits per byte, the least
+ *    significant group first, MSB set when more bytes follow).
+ *
+ *    With -i, the tokens are interned into &struct tok_intern, and the
+ *    statistics of the table are reported to stderr at the end. In the
+ *    binary format, a token seen before is then encoded as its ID plus 1,
+ *    and a new token as 0 followed by the token. IDs are given from 0 in the
+ *    order of the first appearance, so the input is tokenized by a single
+ *    thread regardless of -j.
+ *
+ *    With -j, the file is split into chunks at line boundaries, and worker
+ *    threads tokenize the chunks into their own output arenas. The main
+ *    thread writes out the arenas in the order of the chunks, so the output
+ *    is the same as tokenizing with a single thread. Each thread has one
+ *    arena, and takes the next chunk once the main thread has written out
+ *    the last one.
+ */
+#define OUTPUT_BUFFER_SIZE  (1 << 20)
+#define CHUNK_SIZE          (4 << 20)
+
+/**
+ * Output arena. An arena with @fd >= 0 is flushed to @fd when it is full.
+ * Otherwise, it grows to hold everything put into it.
+ */
+struct arena {
+    int fd;
+    char *buf;
+    size_t len;
+    size_t size;
+    int error;
+};
+
+/**
+ * Spans for the line being tokenized. This grows when a line has more tokens
+ * than ever, so lines do not allocate once it has grown enough.
+ */
+struct span_buffer {
+    struct token_span *spans;
+    int nr_spans_max;
+};
+
+static int write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = write(fd, data, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int arena_init(struct arena *a, int fd, size_t size)
+{
+    a->fd = fd;
+    a->len = 0;
+    a->size = size;
+    a->error = 0;
+    a->buf = malloc(size);
+    return a->buf ? 0 : -ENOMEM;
+}
+
+static int arena_flush(struct arena *a)
+{
+    if (!a->error) a->error = write_all(a->fd, a->buf, a->len);
+    a->len = 0;
+    return a->error;
+}
+
+static inline void emit(struct arena *a, const char *data, size_t len)
+{
+    if (a->len + len > a->size) {
+        if (a->fd >= 0) {
+            arena_flush(a);
+            if (len > a->size) {
+                /* Way too long token. Write it out directly */
+                if (!a->error) a->error = write_all(a->fd, data, len);
+                return;
             }
+        } else {
+            size_t size = a->size * 2;
+            char *buf;
+
+            while (size < a->len + len) size *= 2;
+            buf = realloc(a->buf, size);
+            if (!buf) {
+                a->error = -ENOMEM;
+                return;
+            }
+            a->buf = buf;
+            a->size = size;
         }
-        
-        else{
-            if(command[i]=='"'){
-                i++;
-                while(command[i] != '"'){
-                    tempTokens[j] = command[i];
-                    j++;
-                    i++;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        a->buf[a->len + i] = data[i];
+    }
+    a->len += len;
+}
+
+static inline void emit_decimal(struct arena *a, unsigned long value)
+{
+    char digits[24];
+    int i = sizeof(digits);
+
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    emit(a, digits + i, sizeof(digits) - i);
+}
+
+static inline void emit_leb128(struct arena *a, unsigned long value)
+{
+    char bytes[10];
+    int nr = 0;
+
+    do {
+        bytes[nr] = value & 0x7f;
+        value >>= 7;
+        if (value) bytes[nr] |= 0x80;
+        nr++;
+    } while (value);
+
+    emit(a, bytes, nr);
+}
+
+/**
+ * Intern the tokens with -i. Tokens are given IDs in the order of their first
+ * appearance, so the table is used by a single thread only.
+ */
+static struct tok_intern *__intern;
+
+/**
+ * Intern @token and return true if it has been seen before. Return false for
+ * a new token, or when interning failed which is recorded in @a.
+ */
+static inline bool intern_token(struct arena *a, const char *token, size_t len,
+                                unsigned int *id)
+{
+    unsigned int nr_atoms = __intern->nr_atoms;
+    const struct tok_atom *atom = tok_intern(__intern, token, len);
+
+    if (!atom) {
+        a->error = -ENOMEM;
+        return false;
+    }
+    *id = atom->id;
+    return atom->id < nr_atoms;
+}
+
+static void emit_line(struct arena *a, char *line, struct token_span spans[],
+                      int nr_tokens, bool binary)
+{
+    unsigned int id;
+
+    if (binary) {
+        emit_leb128(a, nr_tokens);
+        for (int i = 0; i < nr_tokens; i++) {
+            if (__intern) {
+                /* (ID + 1) for a seen token, 0 and the token for a new one */
+                if (intern_token(a, line + spans[i].offset, spans[i].len, &id)) {
+                    emit_leb128(a, id + 1);
+                    continue;
                 }
+                emit_leb128(a, 0);
             }
-            else{
-                 tempTokens[j] = command[i];
-                  j++;
-            }
+            emit_leb128(a, spans[i].len);
+            emit(a, line + spans[i].offset, spans[i].len);
         }
-        
-        i++;
+        return;
+    }
+
+    emit(a, "nr_tokens = ", 12);
+    emit_decimal(a, nr_tokens);
+    emit(a, "\n", 1);
+    for (int i = 0; i < nr_tokens; i++) {
+        if (__intern) intern_token(a, line + spans[i].offset, spans[i].len, &id);
+        emit(a, "tokens[", 7);
+        emit_decimal(a, i);
+        emit(a, "] = ", 4);
+        emit(a, line + spans[i].offset, spans[i].len);
+        emit(a, "\n", 1);
+    }
+    emit(a, "\n", 1);
+}
+
+/**
+ * Tokenize the lines in [@p, @end) into @a. The last line should end with
+ * '\n'.
+ */
+static int tokenize_lines(char *p, char *end, bool binary,
+                          struct span_buffer *sb, struct arena *a)
+{
+    if (!sb->spans) {
+        sb->nr_spans_max = MAX_NR_TOKENS;
+        sb->spans = malloc(sizeof(*sb->spans) * sb->nr_spans_max);
+        if (!sb->spans) return -ENOMEM;
     }
 
-    *nr_tokens  = quatationCnt;
+    while (p < end && !a->error) {
+        char *cursor = p;
+        int nr_tokens = 0;
+        int nr;
+
+        while ((nr = tok_line_spans(p, &cursor, __tok_flags,
+                        sb->spans + nr_tokens, sb->nr_spans_max - nr_tokens))
+                == sb->nr_spans_max - nr_tokens) {
+            struct token_span *spans;
+
+            nr_tokens += nr;
+            spans = realloc(sb->spans,
+                            sizeof(*spans) * sb->nr_spans_max * 2);
+            if (!spans) return -ENOMEM;
+            sb->spans = spans;
+            sb->nr_spans_max *= 2;
+        }
+        nr_tokens += nr;
+
+        emit_line(a, p, sb->spans, nr_tokens, binary);
+
+        /* Skip '\n', or '\0' which breaks the line as well */
+        p = cursor + 1;
+    }
+    return a->error;
+}
+
+/**
+ * A chunk of the input file, and the output for it
+ */
+struct chunk {
+    char *start;
+    char *end;
+    struct arena *arena;    /* Of the worker thread */
+    int ret;
+    bool done;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct chunk *chunks;
+    int nr_chunks;
+    int next;       /* Next chunk to tokenize */
+    int written;    /* Number of chunks written out */
+    bool binary;
+} __batch = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *batch_worker(void *arg)
+{
+    struct span_buffer sb = { NULL, 0 };
+    struct arena arena;
+    int ret = arena_init(&arena, -1, CHUNK_SIZE * 2);
+
+    pthread_mutex_lock(&__batch.lock);
+    while (__batch.next < __batch.nr_chunks) {
+        int index = __batch.next++;
+        struct chunk *c = __batch.chunks + index;
+
+        pthread_mutex_unlock(&__batch.lock);
+
+        arena.len = 0;
+        arena.error = 0;
+        c->arena = &arena;
+        c->ret = ret;
+        if (!c->ret) {
+            c->ret = tokenize_lines(c->start, c->end, __batch.binary,
+                                    &sb, &arena);
+        }
+
+        pthread_mutex_lock(&__batch.lock);
+        c->done = true;
+        pthread_cond_broadcast(&__batch.cond);
+
+        /* The arena is ours again once the chunk is written out */
+        while (__batch.written <= index) {
+            pthread_cond_wait(&__batch.cond, &__batch.lock);
+        }
+    }
+    pthread_mutex_unlock(&__batch.lock);
+
+    free(arena.buf);
+    free(sb.spans);
+    return NULL;
+}
+
+static int add_chunk(char *start, char *end)
+{
+    if ((__batch.nr_chunks & (__batch.nr_chunks - 1)) == 0) {
+        /* Grow the array when the number of chunks hits a power of 2 */
+        struct chunk *chunks = realloc(__batch.chunks,
+                sizeof(*chunks) * (__batch.nr_chunks ? __batch.nr_chunks * 2 : 1));
+        if (!chunks) return -ENOMEM;
+        __batch.chunks = chunks;
+    }
+
+    __batch.chunks[__batch.nr_chunks++] = (struct chunk) {
+        .start = start,
+        .end = end,
+    };
     return 0;
 }
 
+static int tokenize_parallel(char *start, char *end, char *tail,
+                             char *tail_end, bool binary, int nr_threads)
+{
+    pthread_t *threads;
+    int nr_started = 0;
+    int ret = 0;
+
+    /* Split into chunks at the line boundaries */
+    while (start < end && !ret) {
+        char *split = end;
+
+        if (end - start > CHUNK_SIZE) {
+            split = start + CHUNK_SIZE;
+            while (split < end && split[-1] != '\n') split++;
+        }
+        ret = add_chunk(start, split);
+        start = split;
+    }
+    if (!ret && tail) ret = add_chunk(tail, tail_end);
+    if (ret) goto out_free;
+
+    __batch.next = __batch.written = 0;
+    __batch.binary = binary;
+
+    threads = malloc(sizeof(*threads) * nr_threads);
+    if (!threads) {
+        ret = -ENOMEM;
+        goto out_free;
+    }
+    for (; nr_started < nr_threads; nr_started++) {
+        if (pthread_create(threads + nr_started, NULL, batch_worker, NULL))
+            break;
+    }
+    if (!nr_started) {
+        ret = -EAGAIN;
+        goto out_threads;
+    }
+
+    /* Write out the chunks in order as they are done */
+    for (int i = 0; i < __batch.nr_chunks; i++) {
+        struct chunk *c = __batch.chunks + i;
+
+        pthread_mutex_lock(&__batch.lock);
+        while (!c->done) pthread_cond_wait(&__batch.cond, &__batch.lock);
+        pthread_mutex_unlock(&__batch.lock);
+
+        if (!ret) ret = c->ret;
+        if (!ret) ret = write_all(STDOUT_FILENO, c->arena->buf, c->arena->len);
+
+        pthread_mutex_lock(&__batch.lock);
+        __batch.written = i + 1;
+        pthread_cond_broadcast(&__batch.cond);
+        pthread_mutex_unlock(&__batch.lock);
+    }
+
+    for (int i = 0; i < nr_started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+out_threads:
+    free(threads);
+out_free:
+    free(__batch.chunks);
+    __batch.chunks = NULL;
+    __batch.nr_chunks = 0;
+    return ret;
+}
+
+/**
+ * Tokenize the stream from @fd with large read()s. Tokens are gathered
+ * into @line until the end of line since the text format needs the number
+ * of tokens first.
+ */
+#define STREAM_READ_SIZE    (64 << 10)
+
+struct stream_output {
+    struct arena line;
+    struct span_buffer sb;
+    int nr_tokens;
+    struct arena *out;
+    bool binary;
+};
+
+static void __stream_token(void *data, char *token, size_t len)
+{
+    struct stream_output *so = data;
+
+    if (so->nr_tokens == so->sb.nr_spans_max) {
+        struct token_span *spans = realloc(so->sb.spans,
+                sizeof(*spans) * so->sb.nr_spans_max * 2);
+        if (!spans) {
+            so->out->error = -ENOMEM;
+            return;
+        }
+        so->sb.spans = spans;
+        so->sb.nr_spans_max *= 2;
+    }
+
+    so->sb.spans[so->nr_tokens].offset = so->line.len;
+    so->sb.spans[so->nr_tokens].len = len;
+    so->nr_tokens++;
+    emit(&so->line, token, len);
+}
+
+static void __stream_line_end(void *data)
+{
+    struct stream_output *so = data;
+
+    emit_line(so->out, so->line.buf, so->sb.spans, so->nr_tokens, so->binary);
+    so->line.len = 0;
+    so->nr_tokens = 0;
+}
+
+static const struct tok_stream_ops __stream_ops = {
+    .token = __stream_token,
+    .line_end = __stream_line_end,
+};
+
+static int tokenize_stream(int fd, bool binary)
+{
+    struct stream_output so = {
+        .binary = binary,
+        .sb.nr_spans_max = MAX_NR_TOKENS,
+    };
+    struct tok_stream ts;
+    struct arena out = { 0 };
+    char *buf;
+    ssize_t len;
+    int ret;
+
+    buf = malloc(STREAM_READ_SIZE + 1);
+    so.sb.spans = malloc(sizeof(*so.sb.spans) * so.sb.nr_spans_max);
+    if (!buf || !so.sb.spans ||
+            arena_init(&so.line, -1, MAX_COMMAND) ||
+            arena_init(&out, STDOUT_FILENO, OUTPUT_BUFFER_SIZE)) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    so.out = &out;
+
+    tok_stream_init(&ts, TOK_QUOTE, &__stream_ops, &so);
+    while ((len = read(fd, buf, STREAM_READ_SIZE)) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            ret = -errno;
+            goto out_fini;
+        }
+        if ((ret = tok_stream_feed(&ts, buf, len))) goto out_fini;
+        if (out.error || so.line.error) break;
+    }
+    ret = tok_stream_finish(&ts);
+    if (!ret) ret = so.line.error ? so.line.error : arena_flush(&out);
+
+out_fini:
+    tok_stream_fini(&ts);
+out:
+    free(out.buf);
+    free(so.line.buf);
+    free(so.sb.spans);
+    free(buf);
+    return ret;
+}
+
+
+static int tokenize_file(const char *filename, bool binary, int nr_threads)
+{
+    int fd = STDIN_FILENO;
+    struct stat st;
+    char *map, *end, *last;
+    char *tail = NULL;
+    size_t tail_len = 0;
+    int ret = 0;
+
+    if (filename) {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "No input file %s\n", filename);
+            return -EINVAL;
+        }
+    }
+
+    if (fstat(fd, &st)) {
+        ret = -errno;
+        goto out_close;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        /* Pipes and terminals cannot be mapped. Stream them instead */
+        if (__tok_flags & TOK_SHELL) {
+            fprintf(stderr, "-s needs a regular file in batch\n");
+            ret = -EINVAL;
+            goto out_close;
+        }
+        ret = tokenize_stream(fd, binary);
+        goto out_close;
+    }
+    if (st.st_size == 0) goto out_close;
+
+    /**
+     * Map privately with write permission; unquoting tokens in place
+     * copies-on-write the touched pages only, and the file is intact.
+     */
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        ret = -errno;
+        goto out_close;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    /**
+     * The scanners stop at the end of line only, so the last line without
+     * '\n' would run off the mapping. Tokenize a terminated copy of it.
+     */
+    end = last = map + st.st_size;
+    if (end[-1] != '\n') {
+        while (last > map && last[-1] != '\n') last--;
+        tail_len = end - last;
+
+        tail = malloc(tail_len + 2);
+        if (!tail) {
+            ret = -ENOMEM;
+            goto out_unmap;
+        }
+        for (size_t i = 0; i < tail_len; i++) tail[i] = last[i];
+        tail[tail_len++] = '\n';
+        tail[tail_len] = '\0';
+    }
+
+    if (nr_threads > 1) {
+        ret = tokenize_parallel(map, last, tail, tail + tail_len,
+                                binary, nr_threads);
+    } else {
+        struct span_buffer sb = { NULL, 0 };
+        struct arena a;
+
+        ret = arena_init(&a, STDOUT_FILENO, OUTPUT_BUFFER_SIZE);
+        if (!ret) ret = tokenize_lines(map, last, binary, &sb, &a);
+        if (!ret && tail) {
+            ret = tokenize_lines(tail, tail + tail_len, binary, &sb, &a);
+        }
+        if (!ret) ret = arena_flush(&a);
+
+        free(a.buf);
+        free(sb.spans);
+    }
+
+    free(tail);
+out_unmap:
+    munmap(map, st.st_size);
+out_close:
+    if (fd != STDIN_FILENO) close(fd);
+    return ret;
+}
+
+
+static void __print_usage(char * const name)
+{
+    fprintf(stderr, "Usage: %s [-s] [-b [-x] [-i] [-j threads]] [input file]\n", name);
+    fprintf(stderr, "  -s : Tokenize in the shell rules with the DFA tokenizer\n");
+    fprintf(stderr, "  -b : Tokenize the whole input file in batch\n");
+    fprintf(stderr, "  -x : Emit the tokens in the binary format in batch\n");
+    fprintf(stderr, "  -i : Intern the tokens and report the statistics\n");
+    fprintf(stderr, "  -j : Tokenize with the threads in batch "
+                    "(0 for the number of CPUs)\n");
+}
+
 
 /***********************************************************************
  * The main function of this program.
- * SHOULD NOT CHANGE THE CODE BELOW THIS LINE
  */
 int main(int argc, char *argv[])
 {
     char line[MAX_COMMAND] = { '\0' };
     FILE *input = stdin;
+    bool batch = false;
+    bool binary = false;
+    bool intern = false;
+    int nr_threads = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sbxij:h")) != -1) {
+        switch (opt) {
+        case 's':
+            __tok_flags = TOK_SHELL;
+            break;
+        case 'b':
+            batch = true;
+            break;
+        case 'i':
+            intern = true;
+            break;
+        case 'x':
+            binary = true;
+            break;
+        case 'j': {
+            char *end;
+
+            nr_threads = strtol(optarg, &end, 10);
+            if (*end || end == optarg || nr_threads < 0) {
+                fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+                __print_usage(argv[0]);
+                return -EINVAL;
+            }
+            if (nr_threads == 0) nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        }
+        case 'h':
+        default:
+            __print_usage(argv[0]);
+            return opt == 'h' ? 0 : -EINVAL;
+        }
+    }
+
+    if (batch) {
+        struct tok_intern ti;
+        int ret;
+
+        if (intern) {
+            if (tok_intern_init(&ti)) return -ENOMEM;
+            __intern = &ti;
+            nr_threads = 1;
+        }
+
+        ret = tokenize_file(optind < argc ? argv[optind] : NULL, binary,
+                            nr_threads);
+
+        if (intern) {
+            fprintf(stderr, "interned: %lu lookups, %lu hits (%.2f%%), "
+                            "%u unique tokens in %lu bytes\n",
+                    ti.nr_lookups, ti.nr_hits,
+                    ti.nr_lookups ? ti.nr_hits * 100.0 / ti.nr_lookups : 0.0,
+                    ti.nr_atoms, ti.nr_bytes);
+            tok_intern_fini(&ti);
+        }
+        return ret;
+    }
 
-    if (argc == 2) {
-        input = fopen(argv[1], "r");
+    if (optind < argc) {
+        input = fopen(argv[optind], "r");
         if (!input) {
-            fprintf(stderr, "No input file %s\n", argv[1]);
+            fprintf(stderr, "No input file %s\n", argv[optind]);
             return -EINVAL;
         }
     }
@@ -0,0 +1,232 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#include "types.h"
+#include "jobs.h"
+
+struct job {
+	int id;
+	struct task *task;
+	char *command;
+};
+
+static struct {
+	struct job **jobs;		/* Indexed by the job id - 1 */
+	int nr_slots;
+	int nr_jobs;
+	int last;				/* The most recent job */
+} __jobs;
+
+static void __free_job(struct job *job, bool free_task_too)
+{
+	__jobs.jobs[job->id - 1] = NULL;
+	__jobs.nr_jobs--;
+	if (__jobs.last == job->id) __jobs.last = 0;
+
+	if (free_task_too) free_task(job->task);
+	free(job->command);
+	free(job);
+}
+
+void jobs_fini(void)
+{
+	for (int i = 0; i < __jobs.nr_slots; i++) {
+		if (__jobs.jobs[i]) __free_job(__jobs.jobs[i], true);
+	}
+	free(__jobs.jobs);
+	__jobs.jobs = NULL;
+	__jobs.nr_slots = 0;
+}
+
+static char *__join(int nr_tokens, char * const tokens[])
+{
+	size_t len = 0;
+	char *command;
+
+	for (int i = 0; i < nr_tokens; i++) len += strlen(tokens[i]) + 1;
+
+	command = malloc(len + 1);
+	if (!command) return NULL;
+
+	command[0] = '\0';
+	for (int i = 0; i < nr_tokens; i++) {
+		if (i) strcat(command, " ");
+		strcat(command, tokens[i]);
+	}
+	return command;
+}
+
+int add_job(struct task *task, int nr_tokens, char * const tokens[])
+{
+	struct job *job;
+	int slot = 0;
+
+	/* Take the lowest free id */
+	while (slot < __jobs.nr_slots && __jobs.jobs[slot]) slot++;
+	if (slot == __jobs.nr_slots) {
+		int nr_slots = __jobs.nr_slots ? __jobs.nr_slots * 2 : 16;
+		struct job **jobs = realloc(__jobs.jobs, sizeof(*jobs) * nr_slots);
+
+		if (!jobs) return -ENOMEM;
+		for (int i = __jobs.nr_slots; i < nr_slots; i++) jobs[i] = NULL;
+		__jobs.jobs = jobs;
+		__jobs.nr_slots = nr_slots;
+	}
+
+	job = malloc(sizeof(*job));
+	if (!job) return -ENOMEM;
+
+	*job = (struct job) {
+		.id = slot + 1,
+		.task = task,
+		.command = __join(nr_tokens, tokens),
+	};
+	if (!job->command) {
+		free(job);
+		return -ENOMEM;
+	}
+
+	__jobs.jobs[slot] = job;
+	__jobs.nr_jobs++;
+	__jobs.last = job->id;
+	return job->id;
+}
+
+static void __print_job(struct job *job)
+{
+	struct task *task = job->task;
+	char state[32] = "Running";
+
+	if (task->nr_running == 0) {
+		if (task->timed_out) {
+			strcpy(state, "Timed out");
+		} else if (task->over_limit) {
+			strcpy(state, "Over limit");
+		} else if (WIFSIGNALED(task->status)) {
+			snprintf(state, sizeof(state), "Killed (%s)",
+					strsignal(WTERMSIG(task->status)));
+		} else if (WEXITSTATUS(task->status)) {
+			snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(task->status));
+		} else {
+			strcpy(state, "Done");
+		}
+	}
+	fprintf(stderr, "[%d]%c %-24s%s\n", job->id,
+			job->id == __jobs.last ? '+' : ' ', state, job->command);
+}
+
+void reap_jobs(void)
+{
+	/* Called before every command. Save the syscalls when nothing's left */
+	if (!__jobs.nr_jobs) return;
+
+	poll_tasks();
+
+	for (int i = 0; i < __jobs.nr_slots; i++) {
+		struct job *job = __jobs.jobs[i];
+
+		if (!job || job->task->nr_running) continue;
+		__print_job(job);
+		__free_job(job, true);
+	}
+}
+
+void print_jobs(void)
+{
+	poll_tasks();
+
+	for (int i = 0; i < __jobs.nr_slots; i++) {
+		struct job *job = __jobs.jobs[i];
+
+		if (!job) continue;
+		__print_job(job);
+		if (!job->task->nr_running) __free_job(job, true);
+	}
+}
+
+static struct job *__find_job(const char *spec)
+{
+	pid_t pid;
+
+	if (!spec) {
+		if (__jobs.last) return __jobs.jobs[__jobs.last - 1];
+
+		/* The most recent one has gone. Take the one with the largest id */
+		for (int i = __jobs.nr_slots - 1; i >= 0; i--) {
+			if (__jobs.jobs[i]) return __jobs.jobs[i];
+		}
+		return NULL;
+	}
+
+	if (spec[0] == '%') {
+		int id = atoi(spec + 1);
+
+		if (id <= 0 || id > __jobs.nr_slots) return NULL;
+		return __jobs.jobs[id - 1];
+	}
+
+	pid = atoi(spec);
+	for (int i = 0; i < __jobs.nr_slots; i++) {
+		struct job *job = __jobs.jobs[i];
+
+		if (!job || pid <= 0) continue;
+		for (int j = 0; j < job->task->nr_pids; j++) {
+			if (job->task->pids[j] == pid) return job;
+		}
+	}
+	return NULL;
+}
+
+int wait_jobs(const char *spec)
+{
+	struct job *job;
+
+	if (spec) {
+		job = __find_job(spec);
+		if (!job) return -ESRCH;
+
+		wait_task(job->task, false);
+		__free_job(job, true);
+		return 0;
+	}
+
+	for (int i = 0; i < __jobs.nr_slots; i++) {
+		job = __jobs.jobs[i];
+		if (!job) continue;
+
+		wait_task(job->task, false);
+		__free_job(job, true);
+	}
+	return 0;
+}
+
+struct task *take_job(const char *spec)
+{
+	struct job *job = __find_job(spec);
+	struct task *task;
+
+	if (!job) return NULL;
+
+	fprintf(stderr, "%s\n", job->command);
+	task = job->task;
+	__free_job(job, false);
+	return task;
+}
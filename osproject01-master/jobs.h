@@ -0,0 +1,84 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+#include <sys/types.h>
+
+#include "types.h"
+#include "supervisor.h"
+
+/**
+ * Background jobs; commands and pipelines ending with "&".
+ *
+ * The shell does not wait for the jobs but goes on taking commands. A job is
+ * a task of the supervisor (see supervisor.h), which reaps its children and
+ * times it out as it does for the foreground tasks. Jobs finished are reported
+ * by reap_jobs() between commands.
+ *
+ * A job is referred to as %<job id>, or by the pid of any of its processes.
+ * Without the job, builtins take the most recent one.
+ */
+
+void jobs_fini(void);
+
+/***********************************************************************
+ * add_job()
+ *
+ * DESCRIPTION
+ *  Register @task as a background job running the command in @tokens. The
+ *  job owns @task from now on.
+ *
+ * RETURN VALUE
+ *  Return the job id, or -ENOMEM.
+ */
+int add_job(struct task *task, int nr_tokens, char * const tokens[]);
+
+/**
+ * Handle the events from the children without blocking, and report the jobs
+ * that have finished.
+ */
+void reap_jobs(void);
+
+/**
+ * Print the jobs as the jobs builtin
+ */
+void print_jobs(void);
+
+/***********************************************************************
+ * wait_jobs()
+ *
+ * DESCRIPTION
+ *  Wait for the job @spec to finish, or for all jobs if @spec is NULL.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -ESRCH if there is no such job.
+ */
+int wait_jobs(const char *spec);
+
+/***********************************************************************
+ * take_job()
+ *
+ * DESCRIPTION
+ *  Take the task of the job @spec out of the job table to wait for it in
+ *  the foreground. The caller frees the task.
+ *
+ * RETURN VALUE
+ *  Return the task, or NULL if there is no such job.
+ */
+struct task *take_job(const char *spec);
+
+#endif
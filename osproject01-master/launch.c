@@ -0,0 +1,264 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "types.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "zygote.h"
+#include "trace.h"
+
+extern char **environ;
+
+enum launcher launcher = LAUNCHER_FORK;
+
+static const char * const __launcher_names[NR_LAUNCHERS] = {
+	[LAUNCHER_FORK] = "fork",
+	[LAUNCHER_VFORK] = "vfork",
+	[LAUNCHER_SPAWN] = "spawn",
+	[LAUNCHER_ZYGOTE] = "zygote",
+};
+
+int set_launcher(const char *name)
+{
+	for (int i = 0; i < NR_LAUNCHERS; i++) {
+		if (strcmp(name, __launcher_names[i]) == 0) {
+			launcher = i;
+			/* zygote_launch() starts it later if this fails */
+			if (launcher == LAUNCHER_ZYGOTE) zygote_start();
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+const char *launcher_name(enum launcher launcher)
+{
+	return launcher < NR_LAUNCHERS ? __launcher_names[launcher] : "unknown";
+}
+
+static int __set_limit(int resource, rlim_t value, rlim_t grace)
+{
+	struct rlimit rlim;
+
+	/* Lowering the hard limit is fine, but raising it is not */
+	if (getrlimit(resource, &rlim)) return -errno;
+	if (value > rlim.rlim_max) value = rlim.rlim_max;
+	if (value + grace < rlim.rlim_max) rlim.rlim_max = value + grace;
+	rlim.rlim_cur = value;
+
+	return setrlimit(resource, &rlim) ? -errno : 0;
+}
+
+static int __set_limits(const struct launch_limits *limits)
+{
+	int ret = 0;
+
+	if (!limits) return 0;
+
+	if (!ret && (limits->set & LIMIT_AS)) {
+		ret = __set_limit(RLIMIT_AS, limits->as, 0);
+	}
+	if (!ret && (limits->set & LIMIT_CPU)) {
+		/* SIGXCPU at the soft limit to tell it from other kills */
+		ret = __set_limit(RLIMIT_CPU, limits->cpu, 1);
+	}
+	if (!ret && (limits->set & LIMIT_NOFILE)) {
+		ret = __set_limit(RLIMIT_NOFILE, limits->nofile, 0);
+	}
+	if (!ret && (limits->set & LIMIT_CPUS) &&
+			sched_setaffinity(0, sizeof(limits->cpus), &limits->cpus)) {
+		ret = -errno;
+	}
+	return ret;
+}
+
+int setup_child(const struct launch_attr *attr)
+{
+	sigset_t none;
+
+	/**
+	 * The shell blocks SIGCHLD to take it from a signalfd, and may ignore
+	 * SIGTTOU; see supervisor.c
+	 */
+	sigemptyset(&none);
+	sigprocmask(SIG_SETMASK, &none, NULL);
+	signal(SIGTTOU, SIG_DFL);
+
+	if (!attr) return 0;
+
+	if (attr->pgid >= 0 && setpgid(0, attr->pgid)) return -errno;
+
+	for (int i = 0; i < 3; i++) {
+		if (attr->fds[i] < 0 || attr->fds[i] == i) continue;
+		if (dup2(attr->fds[i], i) < 0) return -errno;
+	}
+	return __set_limits(attr->limits);
+}
+
+static pid_t __launch_fork(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	pid_t pid = fork();
+
+	if (pid == 0) {
+		int ret = setup_child(attr);
+
+		if (ret) {
+			fprintf(stderr, "%s\n", strerror(-ret));
+			_exit(EXIT_FAILURE);	/* Not exit(); see below */
+		}
+		execv(path, argv);
+
+		/* The shell cannot hear that the cached path has gone. Search again */
+		if (errno == ENOENT && path != argv[0]) execvp(argv[0], argv);
+
+		/**
+		 * Not exit(), which would flush the stdio buffers of the shell, and
+		 * seek the shared stdin back to where the shell has read up to.
+		 */
+		fprintf(stderr, "%s\n", strerror(errno));
+		_exit(127);
+	}
+	return pid < 0 ? -errno : pid;
+}
+
+static pid_t __launch_vfork(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	/**
+	 * The child runs on the memory of the shell while the shell is
+	 * suspended, so it can leave the errno of exec here. It should not
+	 * touch anything else but this before _exit().
+	 */
+	volatile int error = 0;
+	pid_t pid = vfork();
+
+	if (pid == 0) {
+		int ret = setup_child(attr);
+
+		if (ret) {
+			error = -ret;
+			_exit(127);
+		}
+		execv(path, argv);
+		error = errno;
+		_exit(127);
+	}
+	if (pid < 0) return -errno;
+
+	if (error) {
+		waitpid(pid, NULL, 0);
+		return -error;
+	}
+	return pid;
+}
+
+static pid_t __launch_spawn(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t spawnattr;
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+	sigset_t none, defaults;
+	pid_t pid;
+	int ret;
+
+	if ((ret = posix_spawnattr_init(&spawnattr))) return -ret;
+	if ((ret = posix_spawn_file_actions_init(&actions))) {
+		posix_spawnattr_destroy(&spawnattr);
+		return -ret;
+	}
+
+	/* Same as setup_child() */
+	sigemptyset(&none);
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGTTOU);
+	ret = posix_spawnattr_setsigmask(&spawnattr, &none);
+	if (!ret) ret = posix_spawnattr_setsigdefault(&spawnattr, &defaults);
+	if (!ret && attr && attr->pgid >= 0) {
+		ret = posix_spawnattr_setpgroup(&spawnattr, attr->pgid);
+		flags |= POSIX_SPAWN_SETPGROUP;
+	}
+	if (!ret) ret = posix_spawnattr_setflags(&spawnattr, flags);
+
+	for (int i = 0; attr && i < 3 && !ret; i++) {
+		if (attr->fds[i] < 0 || attr->fds[i] == i) continue;
+		ret = posix_spawn_file_actions_adddup2(&actions, attr->fds[i], i);
+	}
+	if (!ret) ret = posix_spawn(&pid, path, &actions, &spawnattr, argv, environ);
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&spawnattr);
+
+	return ret ? -ret : pid;
+}
+
+static pid_t __launch(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	switch (launcher) {
+	case LAUNCHER_VFORK:
+		return __launch_vfork(path, argv, attr);
+	case LAUNCHER_SPAWN:
+		/* posix_spawn() cannot set the limits in the child */
+		if (attr && attr->limits) return __launch_vfork(path, argv, attr);
+		return __launch_spawn(path, argv, attr);
+	case LAUNCHER_ZYGOTE: {
+		pid_t pid = zygote_launch(path, argv, attr);
+
+		/* Fork by itself if the zygote cannot help, e.g., for a huge env */
+		if (pid != -ENOTCONN) return pid;
+		return __launch_fork(path, argv, attr);
+	}
+	case LAUNCHER_FORK:
+	default:
+		return __launch_fork(path, argv, attr);
+	}
+}
+
+pid_t launch_command(char * const argv[], const struct launch_attr *attr)
+{
+	const char *path = path_lookup(argv[0]);
+	double start = trace_now();
+	pid_t pid;
+
+	if (!path) return -ENOENT;
+
+	pid = __launch(path, argv, attr);
+	if (pid == -ENOENT && path != argv[0]) {
+		/* The cached executable has gone. Search PATH again */
+		path_forget(argv[0]);
+		path = path_lookup(argv[0]);
+		if (!path) return -ENOENT;
+
+		pid = __launch(path, argv, attr);
+	}
+
+	/* Set the group from the shell as well, not to race with killing it */
+	if (pid > 0 && attr && attr->pgid >= 0) {
+		setpgid(pid, attr->pgid ? attr->pgid : pid);
+	}
+	trace_span("launch", __launcher_names[launcher], start, 0, "pid", pid);
+	return pid;
+}
@@ -0,0 +1,111 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __LAUNCH_H__
+#define __LAUNCH_H__
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sched.h>
+
+/**
+ * Backends to start external commands. They run the same command in the same
+ * way, and differ in how the child is created.
+ *
+ * fork() copies the page tables of the shell, which gets slow as the shell
+ * grows. vfork() and posix_spawn() share the address space of the shell with
+ * the child until it execs, so their cost does not depend on the size of the
+ * shell. The zygote forks from a small helper process instead; see zygote.h.
+ */
+enum launcher {
+	LAUNCHER_FORK = 0,	/* fork() + execv() */
+	LAUNCHER_VFORK,		/* vfork() + execv() */
+	LAUNCHER_SPAWN,		/* posix_spawn() */
+	LAUNCHER_ZYGOTE,	/* fork() + execve() in the zygote */
+	NR_LAUNCHERS,
+};
+
+extern enum launcher launcher;
+
+/**
+ * Resource limits and CPU affinity the child sets on itself before exec.
+ * Only those in @set are changed, and the others are inherited.
+ */
+enum {
+	LIMIT_AS = 1 << 0,
+	LIMIT_CPU = 1 << 1,
+	LIMIT_NOFILE = 1 << 2,
+	LIMIT_CPUS = 1 << 3,
+};
+
+struct launch_limits {
+	unsigned int set;
+	rlim_t as;			/* Address space in bytes */
+	rlim_t cpu;			/* CPU time in seconds. SIGXCPU, and SIGKILL a second later */
+	rlim_t nofile;		/* Number of open files */
+	cpu_set_t cpus;
+};
+
+/**
+ * How to set up the child before it execs. NULL for &struct launch_attr
+ * makes the child inherit everything from the shell.
+ */
+struct launch_attr {
+	int fds[3];		/* Become stdin, stdout, and stderr. -1 to inherit */
+	pid_t pgid;		/* Process group to join. 0 for a new one, -1 to inherit */
+	const struct launch_limits *limits;	/* NULL to inherit */
+};
+
+#define LAUNCH_ATTR_INIT { .fds = { -1, -1, -1 }, .pgid = 0, .limits = NULL }
+
+/***********************************************************************
+ * set_launcher()
+ *
+ * DESCRIPTION
+ *  Select the launcher by its name; fork, vfork, spawn, or zygote. The
+ *  zygote is started here, before the first command is launched.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -EINVAL if there is no such launcher.
+ */
+int set_launcher(const char *name);
+const char *launcher_name(enum launcher launcher);
+
+/**
+ * Set up the child as @attr says. This runs in the child before exec, even
+ * on the memory of the shell with vfork(), so it should make syscalls only.
+ * Return 0 on success, -errno otherwise.
+ */
+int setup_child(const struct launch_attr *attr);
+
+/***********************************************************************
+ * launch_command()
+ *
+ * DESCRIPTION
+ *  Start @argv[0] with @argv with the current launcher, setting up the
+ *  child with @attr. @argv[0] is looked up in PATH through the path cache
+ *  (see pathcache.h), and a command not in PATH fails without creating a
+ *  child.
+ *
+ *  With the fork launcher, the failure of exec is found in the child, which
+ *  reports it and exits as mysh always did. The other launchers find it in
+ *  the shell, and reap the child before returning.
+ *
+ * RETURN VALUE
+ *  Return the pid of the child, or -errno if the command cannot be started.
+ */
+pid_t launch_command(char * const argv[], const struct launch_attr *attr);
+
+#endif
@@ -0,0 +1,129 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+/**
+ * Benchmark the launchers in launch.c
+ *
+ * Launch ./toy and wait for it over and over with each launcher, and report
+ * the launches per second. The shell may grow large, so the benchmark can
+ * touch some memory beforehand (-m) to see how the launchers scale with the
+ * size of the parent.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
+
+#include "types.h"
+#include "launch.h"
+
+#define NR_LAUNCHES		1000
+
+static double __now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void __print_usage(char * const name)
+{
+	printf("Usage: %s [-n launches] [-m MiB] [command ...]\n", name);
+	printf("\n");
+	printf("  -n: Number of launches per launcher (%d by default)\n", NR_LAUNCHES);
+	printf("  -m: Touch this much memory before launching\n");
+	printf("\n");
+	printf("  The command is ./toy by default. Its stderr goes to /dev/null.\n");
+	printf("\n");
+}
+
+int main(int argc, char * const argv[])
+{
+	char *toy[] = { "./toy", NULL };
+	char * const *command = toy;
+	int nr_launches = NR_LAUNCHES;
+	size_t footprint = 0;
+	double fork_rate = 0;
+	int devnull;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:m:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			nr_launches = atoi(optarg);
+			break;
+		case 'm':
+			footprint = (size_t)atoi(optarg) << 20;
+			break;
+		case 'h':
+		default:
+			__print_usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (optind < argc) command = argv + optind;
+	if (nr_launches <= 0) nr_launches = NR_LAUNCHES;
+
+	if (footprint) {
+		char *p = malloc(footprint);
+		if (!p) {
+			fprintf(stderr, "Cannot allocate %zu MiB\n", footprint >> 20);
+			return EXIT_FAILURE;
+		}
+		memset(p, 0xa5, footprint);
+	}
+
+	/* Children inherit the quiet stderr */
+	devnull = open("/dev/null", O_WRONLY);
+	if (devnull < 0 || dup2(devnull, STDERR_FILENO) < 0) {
+		perror("/dev/null");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-8s %10s %12s %10s   (%s, %zu MiB touched)\n", "launcher",
+			"launches", "launches/s", "vs. fork", command[0], footprint >> 20);
+
+	for (int l = 0; l < NR_LAUNCHERS; l++) {
+		double start, elapsed, rate;
+
+		launcher = l;
+		start = __now_ns();
+		for (int i = 0; i < nr_launches; i++) {
+			pid_t pid = launch_command(command, NULL);
+
+			if (pid < 0) {
+				printf("%-8s cannot launch %s: %s\n", launcher_name(l),
+						command[0], strerror(-pid));
+				return EXIT_FAILURE;
+			}
+			waitpid(pid, NULL, 0);
+		}
+		elapsed = __now_ns() - start;
+
+		rate = nr_launches / (elapsed / 1e9);
+		if (l == LAUNCHER_FORK) fork_rate = rate;
+
+		printf("%-8s %10d %12.0f %9.2fx\n", launcher_name(l),
+				nr_launches, rate, rate / fork_rate);
+	}
+
+	return EXIT_SUCCESS;
+}
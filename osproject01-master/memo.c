@@ -0,0 +1,468 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "types.h"
+#include "pathcache.h"
+#include "memo.h"
+
+#define MEMO_MAGIC	0x6f6d656d	/* "memo" */
+
+/**
+ * An entry is the header, followed by the key, the stdout, and the stderr
+ */
+struct memo_header {
+	uint32_t magic;
+	int32_t status;
+	uint64_t key_len;
+	uint64_t out_len;
+	uint64_t err_len;
+};
+
+/**
+ * What is keyed for an argument naming a file. @index tells which one
+ */
+struct memo_file {
+	uint32_t index;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+};
+
+static struct {
+	bool initialized;
+	char dir[PATH_MAX];
+	unsigned long limit;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long stores;
+	unsigned long evictions;
+} __memo = {
+	.limit = MEMO_DEFAULT_LIMIT,
+};
+
+/**
+ * Make the directories of @path as mkdir -p does
+ */
+static int __mkdirs(char *path)
+{
+	for (char *p = path + 1; *p; p++) {
+		if (*p != '/') continue;
+		*p = '\0';
+		if (mkdir(path, 0700) && errno != EEXIST) {
+			*p = '/';
+			return -errno;
+		}
+		*p = '/';
+	}
+	if (mkdir(path, 0700) && errno != EEXIST) return -errno;
+	return 0;
+}
+
+static int __init(void)
+{
+	const char *dir = getenv("MYSH_MEMO_DIR");
+	int len;
+
+	if (__memo.initialized) return 0;
+
+	if (dir && *dir == '/') {
+		len = snprintf(__memo.dir, sizeof(__memo.dir), "%s", dir);
+	} else if (dir && *dir) {
+		/* Stay in the same directory after cd */
+		char cwd[PATH_MAX];
+
+		if (!getcwd(cwd, sizeof(cwd))) return -errno;
+		len = snprintf(__memo.dir, sizeof(__memo.dir), "%s/%s", cwd, dir);
+	} else if ((dir = getenv("XDG_CACHE_HOME")) && *dir) {
+		len = snprintf(__memo.dir, sizeof(__memo.dir), "%s/mysh/memo", dir);
+	} else if ((dir = getenv("HOME")) && *dir) {
+		len = snprintf(__memo.dir, sizeof(__memo.dir), "%s/.cache/mysh/memo", dir);
+	} else {
+		return -ENOENT;
+	}
+	if (len >= sizeof(__memo.dir)) return -ENAMETOOLONG;
+
+	len = __mkdirs(__memo.dir);
+	if (len) return len;
+
+	__memo.initialized = true;
+	return 0;
+}
+
+static int __append(struct memo_key *key, const void *data, size_t len)
+{
+	if (key->len + len > key->size) {
+		size_t size = key->size ? key->size : 256;
+		char *buf;
+
+		while (size < key->len + len) size *= 2;
+		buf = realloc(key->buf, size);
+		if (!buf) return -ENOMEM;
+		key->buf = buf;
+		key->size = size;
+	}
+	memcpy(key->buf + key->len, data, len);
+	key->len += len;
+	return 0;
+}
+
+/**
+ * Key the file at @path if any, or what follows '=' as in --file=path
+ */
+static int __append_file(struct memo_key *key, uint32_t index, const char *path, int fd)
+{
+	struct memo_file file;
+	struct stat st;
+
+	if (fd >= 0) {
+		if (fstat(fd, &st) || !S_ISREG(st.st_mode)) return 0;
+	} else if (stat(path, &st)) {
+		const char *value = strchr(path, '=');
+
+		if (!value || stat(value + 1, &st)) return 0;
+	}
+
+	memset(&file, 0, sizeof(file));	/* Zero the padding, which is keyed too */
+	file.index = index;
+	file.dev = st.st_dev;
+	file.ino = st.st_ino;
+	file.size = st.st_size;
+	file.mtime_sec = st.st_mtim.tv_sec;
+	file.mtime_nsec = st.st_mtim.tv_nsec;
+	return __append(key, &file, sizeof(file));
+}
+
+/**
+ * 64-bit FNV-1a. Collisions are told by the whole key in the entry
+ */
+static unsigned long long __hash(const char *buf, size_t len)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)buf[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+int memo_key(struct memo_key *key, int nr_tokens, char * const tokens[],
+		char * const argv[], int in)
+{
+	char cwd[PATH_MAX];
+	const char *path;
+	uint32_t nr = nr_tokens;
+	int ret;
+
+	memset(key, 0, sizeof(*key));
+	if (!getcwd(cwd, sizeof(cwd))) return -errno;
+
+	/* Strings are terminated with '\0', and the files follow them */
+	ret = __append(key, &nr, sizeof(nr));
+	if (!ret) ret = __append(key, cwd, strlen(cwd) + 1);
+	for (int i = 0; !ret && i < nr_tokens; i++) {
+		ret = __append(key, tokens[i], strlen(tokens[i]) + 1);
+	}
+
+	/* The executable itself, as it would be run */
+	path = path_lookup(argv[0]);
+	if (!ret && path) ret = __append_file(key, 0, path, -1);
+	for (int i = 1; !ret && argv[i]; i++) {
+		ret = __append_file(key, i, argv[i], -1);
+	}
+	if (!ret && in >= 0) ret = __append_file(key, UINT32_MAX, NULL, in);
+
+	if (ret) {
+		memo_key_free(key);
+		return ret;
+	}
+	key->hash = __hash(key->buf, key->len);
+	return 0;
+}
+
+void memo_key_free(struct memo_key *key)
+{
+	free(key->buf);
+	key->buf = NULL;
+	key->len = key->size = 0;
+}
+
+static void __entry_path(char *path, size_t size, const struct memo_key *key)
+{
+	snprintf(path, size, "%s/%016llx", __memo.dir, key->hash);
+}
+
+/**
+ * Copy @len bytes of @in from @offset to @out
+ */
+static int __copy(int in, off_t offset, size_t len, int out)
+{
+	bool by_hand = false;
+
+	while (len) {
+		ssize_t ret = -1;
+
+		if (!by_hand) {
+			ret = sendfile(out, in, &offset, len);
+			/* Some fds cannot take sendfile(). Copy the rest by hand */
+			if (ret < 0 && errno == EINVAL) by_hand = true;
+		}
+		if (by_hand) {
+			char chunk[4096];
+
+			ret = pread(in, chunk, len < sizeof(chunk) ? len : sizeof(chunk), offset);
+			if (ret > 0 && write(out, chunk, ret) != ret) return -EIO;
+			if (ret > 0) offset += ret;
+		}
+		if (ret < 0) return -errno;
+		if (ret == 0) return -EIO;	/* Truncated */
+		len -= ret;
+	}
+	return 0;
+}
+
+int memo_replay(const struct memo_key *key, int out, int err)
+{
+	char path[PATH_MAX + 32];
+	struct memo_header header;
+	char *stored = NULL;
+	int fd, ret;
+
+	ret = __init();
+	if (ret) return ret;
+
+	__entry_path(path, sizeof(path), key);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	ret = -ENOENT;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) goto out;
+	if (header.magic != MEMO_MAGIC || header.key_len != key->len) goto out;
+
+	stored = malloc(key->len);
+	if (!stored) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (pread(fd, stored, key->len, sizeof(header)) != key->len) goto out;
+	if (memcmp(stored, key->buf, key->len)) goto out;
+
+	ret = __copy(fd, sizeof(header) + header.key_len, header.out_len, out);
+	if (!ret) ret = __copy(fd, sizeof(header) + header.key_len + header.out_len,
+			header.err_len, err);
+	if (!ret) ret = header.status;
+
+	/* Used just now for the LRU */
+	futimens(fd, NULL);
+out:
+	if (ret == -ENOENT) __memo.misses++;
+	else if (ret >= 0) __memo.hits++;
+	free(stored);
+	if (fd >= 0) close(fd);
+	return ret;
+}
+
+struct memo_entry {
+	char name[32];
+	off_t size;
+	struct timespec mtime;
+};
+
+static int __compare_entries(const void *a, const void *b)
+{
+	const struct memo_entry *x = a, *y = b;
+
+	if (x->mtime.tv_sec != y->mtime.tv_sec)
+		return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+	if (x->mtime.tv_nsec != y->mtime.tv_nsec)
+		return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+	return 0;
+}
+
+/***********************************************************************
+ * __scan()
+ *
+ * DESCRIPTION
+ *  List the entries in the cache directory into @entries, which the caller
+ *  frees, and sum their sizes to @total. Files of other names, such as the
+ *  ones being stored, are skipped.
+ *
+ * RETURN VALUE
+ *  Return the number of entries, or -errno.
+ */
+static int __scan(struct memo_entry **entries, unsigned long *total)
+{
+	DIR *dir = opendir(__memo.dir);
+	struct dirent *ent;
+	struct memo_entry *list = NULL;
+	int nr = 0, max = 0;
+
+	*total = 0;
+	if (!dir) return -errno;
+
+	while ((ent = readdir(dir))) {
+		struct stat st;
+
+		if (strlen(ent->d_name) != 16 ||
+				strspn(ent->d_name, "0123456789abcdef") != 16) continue;
+		if (fstatat(dirfd(dir), ent->d_name, &st, 0) || !S_ISREG(st.st_mode)) continue;
+
+		if (nr == max) {
+			struct memo_entry *more;
+
+			max = max ? max * 2 : 64;
+			more = realloc(list, sizeof(*list) * max);
+			if (!more) {
+				free(list);
+				closedir(dir);
+				return -ENOMEM;
+			}
+			list = more;
+		}
+		strcpy(list[nr].name, ent->d_name);
+		list[nr].size = st.st_size;
+		list[nr].mtime = st.st_mtim;
+		*total += st.st_size;
+		nr++;
+	}
+	closedir(dir);
+
+	*entries = list;
+	return nr;
+}
+
+/**
+ * Evict the least recently used entries until the rest fit in the limit
+ */
+static void __evict(void)
+{
+	struct memo_entry *entries = NULL;
+	unsigned long total;
+	int nr = __scan(&entries, &total);
+
+	if (nr <= 0) return;
+
+	if (total > __memo.limit) {
+		char path[PATH_MAX + 32];
+
+		qsort(entries, nr, sizeof(*entries), __compare_entries);
+		for (int i = 0; i < nr && total > __memo.limit; i++) {
+			snprintf(path, sizeof(path), "%s/%s", __memo.dir, entries[i].name);
+			if (unlink(path)) continue;
+			total -= entries[i].size;
+			__memo.evictions++;
+		}
+	}
+	free(entries);
+}
+
+int memo_store(const struct memo_key *key, int status, int out, int err)
+{
+	char path[PATH_MAX + 32], tmp[PATH_MAX + 32];
+	struct memo_header header = {
+		.magic = MEMO_MAGIC,
+		.status = status,
+		.key_len = key->len,
+	};
+	struct stat st;
+	int fd, ret;
+
+	ret = __init();
+	if (ret) return ret;
+
+	if (fstat(out, &st)) return -errno;
+	header.out_len = st.st_size;
+	if (fstat(err, &st)) return -errno;
+	header.err_len = st.st_size;
+
+	/* Never evict everything else for what does not fit anyway */
+	if (sizeof(header) + header.key_len + header.out_len + header.err_len > __memo.limit)
+		return -EFBIG;
+
+	/* Write aside and rename, so a replay never sees a partial entry */
+	snprintf(tmp, sizeof(tmp), "%s/.store.XXXXXX", __memo.dir);
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0) return -errno;
+
+	if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+			write(fd, key->buf, key->len) != key->len) {
+		ret = -EIO;
+	}
+	if (!ret) ret = __copy(out, 0, header.out_len, fd);
+	if (!ret) ret = __copy(err, 0, header.err_len, fd);
+	close(fd);
+
+	__entry_path(path, sizeof(path), key);
+	if (!ret && rename(tmp, path)) ret = -errno;
+	if (ret) {
+		unlink(tmp);
+		return ret;
+	}
+
+	__memo.stores++;
+	__evict();
+	return 0;
+}
+
+void memo_set_limit(unsigned long limit)
+{
+	__memo.limit = limit;
+	if (__init() == 0) __evict();
+}
+
+void memo_flush(void)
+{
+	unsigned long limit = __memo.limit;
+
+	__memo.limit = 0;
+	if (__init() == 0) __evict();
+	__memo.limit = limit;
+}
+
+void memo_print(void)
+{
+	struct memo_entry *entries = NULL;
+	unsigned long total = 0;
+	int nr;
+
+	if (__init()) {
+		printf("memo: no cache directory\n");
+		return;
+	}
+	nr = __scan(&entries, &total);
+	free(entries);
+
+	printf("%lu hits, %lu misses, %lu stored, %lu evicted\n",
+			__memo.hits, __memo.misses, __memo.stores, __memo.evictions);
+	printf("%d entries, %lu of %lu KiB in %s\n",
+			nr > 0 ? nr : 0, total >> 10, __memo.limit >> 10, __memo.dir);
+}
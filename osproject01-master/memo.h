@@ -0,0 +1,103 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __MEMO_H__
+#define __MEMO_H__
+
+#include <stddef.h>
+
+#include "types.h"
+
+/**
+ * Cache of the output of deterministic commands for the memo builtin.
+ *
+ * A command is keyed by its tokens, the current directory, and the inode,
+ * size, and mtime of the executable and of every argument naming a file,
+ * including the file redirected to stdin. The environment is not keyed.
+ *
+ * Each entry is a file in the cache directory named after the hash of the
+ * key. It holds the key to tell collisions, the wait status, and the stdout
+ * and stderr of the command, so a hit is replayed with sendfile() without
+ * forking. The directory is $MYSH_MEMO_DIR, or mysh/memo under
+ * $XDG_CACHE_HOME or ~/.cache.
+ *
+ * A hit touches the mtime of its entry, and the least recently used entries
+ * are evicted once the entries grow over the size limit.
+ */
+#define MEMO_DEFAULT_LIMIT	(64UL << 20)
+
+struct memo_key {
+	unsigned long long hash;
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+/***********************************************************************
+ * memo_key()
+ *
+ * DESCRIPTION
+ *  Build @key of the command in @tokens, which is @argv once redirect()
+ *  strips the redirections. @in is the stdin of the command, which is keyed
+ *  when it is a regular file.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -errno otherwise. Free @key with memo_key_free().
+ */
+int memo_key(struct memo_key *key, int nr_tokens, char * const tokens[],
+		char * const argv[], int in);
+void memo_key_free(struct memo_key *key);
+
+/***********************************************************************
+ * memo_replay()
+ *
+ * DESCRIPTION
+ *  Copy the stdout and stderr cached for @key to @out and @err.
+ *
+ * RETURN VALUE
+ *  Return the wait status of the command on a hit, -ENOENT on a miss, or
+ *  other -errno when the cache cannot be used.
+ */
+int memo_replay(const struct memo_key *key, int out, int err);
+
+/***********************************************************************
+ * memo_store()
+ *
+ * DESCRIPTION
+ *  Cache @status and the output in @out and @err for @key, and evict the
+ *  least recently used entries over the limit. @out and @err are read from
+ *  the start, and stay open.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -errno otherwise.
+ */
+int memo_store(const struct memo_key *key, int status, int out, int err);
+
+/**
+ * Set the size limit of the cache to @limit bytes, evicting the entries over it
+ */
+void memo_set_limit(unsigned long limit);
+
+/**
+ * Remove all the entries from the cache
+ */
+void memo_flush(void);
+
+/**
+ * Print the hits and misses so far, and the entries in the cache
+ */
+void memo_print(void);
+
+#endif
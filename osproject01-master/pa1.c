@@ -16,28 +16,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <getopt.h>
 
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 
 #include "types.h"
 #include "parser.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "pipeline.h"
+#include "jobs.h"
+#include "supervisor.h"
+#include "script.h"
+#include "stats.h"
+#include "zygote.h"
+#include "redirect.h"
+#include "memo.h"
+#include "trace.h"
 
-/*====================================================================*/
-/*          ****** DO NOT MODIFY ANYTHING FROM THIS LINE ******       */
 /**
  * String used as the prompt (see @main()). You may change this to
  * change the prompt */
 static char __prompt[MAX_TOKEN_LEN] = "$";
 
 /**
- * Time out value. It's OK to read this value, but ** SHOULD NOT CHANGE
- * IT DIRECTLY **. Instead, use @set_timeout() function below.
+ * Time out value in milliseconds. It's OK to read this value, but ** SHOULD
+ * NOT CHANGE IT DIRECTLY **. Instead, use @set_timeout() function below.
  */
-static unsigned int __timeout = 2;
+static unsigned int __timeout = 2000;
 
 static void set_timeout(unsigned int timeout)
 {
@@ -46,13 +61,11 @@ static void set_timeout(unsigned int timeout)
 	if (__timeout == 0) {
 		fprintf(stderr, "Timeout is disabled\n");
 	} else {
-		fprintf(stderr, "Timeout is set to %d second%s\n",
-				__timeout,
-				__timeout >= 2 ? "s" : "");
+		fprintf(stderr, "Timeout is set to %g second%s\n",
+				__timeout / 1000.0,
+				__timeout >= 2000 ? "s" : "");
 	}
 }
-/*          ****** DO NOT MODIFY ANYTHING UP TO THIS LINE ******      */
-/*====================================================================*/
 
 
 /***********************************************************************
@@ -67,47 +80,829 @@ static void set_timeout(unsigned int timeout)
  *   Return 0 when user inputs "exit"
  *   Return <0 on error
  */
-pid_t cpid;
-char*name;
-void signal_handler(int signal_handler){
-	kill(cpid,SIGKILL);
-	fprintf(stderr,"%s is timed out\n",name);
-}
-//sigaction->signal handler overriding,alarm, kill
-struct sigaction sa={
-	.sa_handler = signal_handler,
-	.sa_flags =0,
-},old_sa;
+//parse the timeout in seconds like 2 or 0.25 into milliseconds
+static unsigned int parse_timeout(const char *str)
+{
+    double seconds = strtod(str, NULL);
 
-static int run_command(int nr_tokens, char *tokens[])
+    return seconds > 0 ? (unsigned int)(seconds * 1000 + 0.5) : 0;
+}
+
+//limit [-v MiB] [-t seconds] [-n files] [-r] [command]
+//affinity CPUS|-r [command]
+//with a command, they are for the command only, e.g., for or each running a block of commands.
+//without one, they are for all the commands after
+static struct launch_limits __limits;
+
+//parse CPUS like 0-3,6
+static int parse_cpus(const char *str, cpu_set_t *cpus)
 {
-    /* This function is all yours. Good luck! */
-    //built-in command
-    if (strncmp(tokens[0], "exit", strlen("exit")) == 0) {
+    cpu_set_t allowed;
+
+    CPU_ZERO(cpus);
+    while(*str){
+        char *end;
+        long first=strtol(str, &end, 10), last=first;
+
+        if(end==str || first<0) return -1;
+        if(*end=='-') last=strtol(end+1, &end, 10);
+        if(last<first || last>=CPU_SETSIZE) return -1;
+        for(long i=first;i<=last;i++) CPU_SET(i, cpus);
+
+        if(*end==',') end++;
+        else if(*end) return -1;
+        str=end;
+    }
+    //only those the shell may run on
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0) CPU_AND(cpus, cpus, &allowed);
+    return CPU_COUNT(cpus) ? 0 : -1;
+}
+
+//parse the options of limit and affinity into limits. Return the index of the command after them, or -1
+static int parse_limits(int nr_tokens, char * const tokens[], struct launch_limits *limits)
+{
+    int i=1;
+
+    if(strcmp(tokens[0], "affinity") == 0){
+        if(nr_tokens<2) return 1;
+        if(strcmp(tokens[1], "-r") == 0){
+            limits->set&=~LIMIT_CPUS;
+        }
+        else {
+            if(parse_cpus(tokens[1], &limits->cpus)) return -1;
+            limits->set|=LIMIT_CPUS;
+        }
+        return 2;
+    }
+
+    while(i<nr_tokens && tokens[i][0]=='-'){
+        unsigned long long value;
+        char *end;
+
+        if(strcmp(tokens[i], "-r") == 0){
+            limits->set&=LIMIT_CPUS;
+            i++;
+            continue;
+        }
+        if(i+1>=nr_tokens || tokens[i][2]) return -1;
+        value=strtoull(tokens[i+1], &end, 10);
+        if(*end || end==tokens[i+1]) return -1;
+
+        switch(tokens[i][1]){
+        case 'v':
+            limits->as=(rlim_t)value<<20;
+            limits->set|=LIMIT_AS;
+            break;
+        case 't':
+            limits->cpu=value;
+            limits->set|=LIMIT_CPU;
+            break;
+        case 'n':
+            limits->nofile=value;
+            limits->set|=LIMIT_NOFILE;
+            break;
+        default:
+            return -1;
+        }
+        i+=2;
+    }
+    return i;
+}
+
+static void print_limits(bool affinity)
+{
+    if(affinity){
+        if(!(__limits.set & LIMIT_CPUS)){
+            fprintf(stderr, "All CPUs\n");
+            return;
+        }
+        fprintf(stderr, "CPUs");
+        for(int i=0;i<CPU_SETSIZE;i++){
+            int last=i;
+
+            if(!CPU_ISSET(i, &__limits.cpus)) continue;
+            while(last+1<CPU_SETSIZE && CPU_ISSET(last+1, &__limits.cpus)) last++;
+            if(last==i) fprintf(stderr, " %d", i);
+            else fprintf(stderr, " %d-%d", i, last);
+            i=last;
+        }
+        fprintf(stderr, "\n");
+        return;
+    }
+
+    if(!(__limits.set & ~LIMIT_CPUS)){
+        fprintf(stderr, "No limits\n");
+        return;
+    }
+    if(__limits.set & LIMIT_AS)
+        fprintf(stderr, "Address space %lu MiB\n", (unsigned long)(__limits.as >> 20));
+    if(__limits.set & LIMIT_CPU)
+        fprintf(stderr, "CPU time %lu seconds\n", (unsigned long)__limits.cpu);
+    if(__limits.set & LIMIT_NOFILE)
+        fprintf(stderr, "Open files %lu\n", (unsigned long)__limits.nofile);
+}
+
+//set the limits as limit or affinity says. Return the index of the command to run under them, 0 for none
+static int set_limits(int nr_tokens, char * const tokens[])
+{
+    struct launch_limits limits=__limits;
+    int first;
+
+    if(nr_tokens==1){
+        print_limits(strcmp(tokens[0], "affinity") == 0);
         return 0;
     }
 
-    else if (strncmp(tokens[0], "prompt", strlen("prompt")) == 0) {
-        strcpy(__prompt, tokens[1]);
+    first=parse_limits(nr_tokens, tokens, &limits);
+    if(first<0){
+        if(strcmp(tokens[0], "affinity") == 0)
+            fprintf(stderr, "Usage: affinity CPUS|-r [command]\n");
+        else
+            fprintf(stderr, "Usage: limit [-v MiB] [-t seconds] [-n files] [-r] [command]\n");
+        return 0;
+    }
+    __limits=limits;
+    return first<nr_tokens ? first : 0;
+}
+
+//start the external command or the pipeline as a task supervised with the timeout
+//io sets up the fds of a command. NULL to inherit them
+static struct task *start_external(int nr_tokens, char *tokens[], const struct launch_attr *io)
+{
+    pid_t cpids[MAX_NR_TOKENS];   //more than one for a pipeline
+    int nr_cpids=0;
+    char *name=tokens[0];
+    struct launch_attr attr = LAUNCH_ATTR_INIT;   //in a process group of its own
+    struct task *task;
+
+    if(io) memcpy(attr.fds, io->fds, sizeof(attr.fds));
+    if(__limits.set) attr.limits=&__limits;
+
+    if(is_pipeline(nr_tokens, tokens)) {
+        nr_cpids=launch_pipeline(nr_tokens, tokens, &attr, cpids);
+        if(nr_cpids<0) nr_cpids=0;
+    }
+    else {
+        char *argv[MAX_NR_TOKENS];
+        int fds[3] = REDIRECT_INIT;
+        pid_t cpid;
+        int nr_args;
+
+        //< > >> 2> <<< are opened here, and the rest goes to argv
+        nr_args=redirect(nr_tokens, tokens, argv, fds);
+        if(nr_args<=0){
+            //only the redirections, like > file, just create the files
+            if(nr_args==0) redirect_close(fds);
+            return NULL;
+        }
+        name=argv[0];
+
+        for(int i=0;i<3;i++){
+            if(fds[i]>=0) attr.fds[i]=fds[i];
+        }
+        cpid=launch_command(argv, &attr);
+        redirect_close(fds);
+
+        if(cpid<0){
+            //exec failed in the shell with vfork or spawn
+            fprintf(stderr, "%s\n", strerror(-cpid));
+        }
+        else {
+            cpids[0]=cpid;
+            nr_cpids=1;
+        }
+    }
+    if(nr_cpids==0) return NULL;
+
+    //the supervisor kills the whole process group on timeout
+    task=supervise(cpids, nr_cpids, name, __timeout);
+    if(!task){
+        //not to leave them running without the timeout
+        fprintf(stderr, "Cannot supervise %s\n", name);
+        kill(-cpids[0], SIGKILL);
+    }
+    else task->limits=__limits;     //to tell when they are hit
+    return task;
+}
+
+//run the external command or the pipeline, and wait for it unless it ends with &
+static void run_external(int nr_tokens, char *tokens[])
+{
+    struct task *task;
+    char *amp = NULL;
+
+    if(nr_tokens > 1 && strcmp(tokens[nr_tokens-1], "&") == 0){
+        //hide & from argv, and put it back for the next iteration of for
+        amp = tokens[--nr_tokens];
+        tokens[nr_tokens] = NULL;
+    }
+
+    task=start_external(nr_tokens, tokens, NULL);
+    if(amp) tokens[nr_tokens]=amp;
+    if(!task) return;
+
+    if(amp){
+        int id = add_job(task, nr_tokens, tokens);
+
+        if(id<0){
+            fprintf(stderr, "Cannot add a job: %s\n", strerror(-id));
+            wait_task(task, false);
+            free_task(task);
+        }
+        else fprintf(stderr, "[%d] %d\n", id, task->pids[task->nr_pids-1]);
+    }
+    else {
+        wait_task(task, true);
+        free_task(task);
+    }
+}
+
+//pfor N [-j K] cmd: run N iterations of cmd with up to K of them at once
+#define PFOR_INDEX_ENV "PFOR_INDEX"
+#define PFOR_MAX_FAILURES 10    //failures to list in the summary
+
+static void run_pfor(int nr_tokens, char *tokens[])
+{
+    int nr_iters, nr_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int next=0, nr_done=0, nr_failed=0, nr_timed_out=0;
+    int first=2;
+    struct task **running;
+    int *indices;
+    int nr_running=0;
+    struct timespec start, end;
+
+    if(nr_tokens < 3){
+        fprintf(stderr, "Usage: pfor N [-j K] command\n");
+        return;
+    }
+    nr_iters=atoi(tokens[1]);
+    if(strcmp(tokens[2], "-j") == 0 && nr_tokens > 4){
+        nr_jobs=atoi(tokens[3]);
+        first=4;
+    }
+    if(nr_jobs<=0) nr_jobs=1;
+    if(nr_jobs>nr_iters) nr_jobs=nr_iters;
+    if(nr_iters<=0) return;
+
+    running=malloc(sizeof(*running) * nr_jobs);
+    indices=malloc(sizeof(*indices) * nr_jobs);
+    if(!running || !indices){
+        fprintf(stderr, "pfor: %s\n", strerror(ENOMEM));
+        free(running);
+        free(indices);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while(nr_done < nr_iters){
+        //keep K iterations in flight
+        while(next < nr_iters && nr_running < nr_jobs){
+            char index[16];
+            struct task *task;
+
+            //the children take the environment at launch
+            snprintf(index, sizeof(index), "%d", next);
+            setenv(PFOR_INDEX_ENV, index, 1);
+
+            task=start_external(nr_tokens-first, tokens+first, NULL);
+            if(!task){
+                if(nr_failed++ < PFOR_MAX_FAILURES)
+                    fprintf(stderr, "pfor: #%d cannot start\n", next);
+                nr_done++;
+            }
+            else {
+                running[nr_running]=task;
+                indices[nr_running++]=next;
+            }
+            next++;
+        }
+        if(nr_running==0) continue;
+
+        wait_events();
+
+        for(int i=0;i<nr_running;){
+            struct task *task=running[i];
+            int status=task->status;
+
+            if(task->nr_running){
+                i++;
+                continue;
+            }
+            if(task->timed_out) nr_timed_out++;
+            if(task->timed_out || !WIFEXITED(status) || WEXITSTATUS(status)){
+                if(nr_failed++ < PFOR_MAX_FAILURES){
+                    if(task->timed_out)
+                        fprintf(stderr, "pfor: #%d timed out\n", indices[i]);
+                    else if(task->over_limit)
+                        fprintf(stderr, "pfor: #%d is over a limit\n", indices[i]);
+                    else if(WIFSIGNALED(status))
+                        fprintf(stderr, "pfor: #%d killed by %s\n", indices[i], strsignal(WTERMSIG(status)));
+                    else
+                        fprintf(stderr, "pfor: #%d exited with %d\n", indices[i], WEXITSTATUS(status));
+                }
+            }
+            free_task(task);
+            nr_done++;
+
+            //fill the hole with the last one
+            running[i]=running[--nr_running];
+            indices[i]=indices[nr_running];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    unsetenv(PFOR_INDEX_ENV);
+
+    fprintf(stderr, "pfor: %d iteration%s with %d at once, %d failed (%d timed out) in %.3f seconds\n",
+            nr_iters, nr_iters >= 2 ? "s" : "", nr_jobs, nr_failed, nr_timed_out,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    free(running);
+    free(indices);
+}
+
+//stdin of the shell is read into this buffer by blocks, not through the FILE of stdio,
+//so the shell can tell if a whole line is there before waiting for more
+#define INPUT_BUF_SIZE (64 << 10)
+
+static struct {
+    char buf[INPUT_BUF_SIZE];
+    size_t start, end;      //of the bytes not taken yet
+    bool eof;
+} __input;
+
+//take the next line of stdin into *line like getline(), supervising the timed
+//children while waiting for it. Return the length, or -1 at the end of the input
+static ssize_t read_input(char **line, size_t *size)
+{
+    size_t len=0;
+
+    for(;;){
+        char *start=__input.buf+__input.start;
+        size_t avail=__input.end-__input.start;
+        char *newline=memchr(start, '\n', avail);
+        size_t take=newline ? newline-start+1 : avail;
+        ssize_t nr;
+
+        //a line longer than the buffer is gathered in *line piece by piece
+        if(newline || __input.eof || avail == INPUT_BUF_SIZE){
+            if(len+take+1 > *size){
+                char *grown=realloc(*line, len+take+1);
+
+                if(!grown) return -1;
+                *line=grown;
+                *size=len+take+1;
+            }
+            memcpy(*line+len, start, take);
+            len+=take;
+            (*line)[len]='\0';
+            __input.start+=take;
+            if(newline) return len;
+            if(__input.eof && __input.start == __input.end) return len ? (ssize_t)len : -1;
+            continue;
+        }
+
+        //no whole line yet. Move the rest to the front, and read more
+        memmove(__input.buf, start, avail);
+        __input.start=0;
+        __input.end=avail;
+
+        wait_readable(STDIN_FILENO);
+        nr=read(STDIN_FILENO, __input.buf+__input.end, INPUT_BUF_SIZE-__input.end);
+        if(nr<0 && errno == EINTR) continue;
+        if(nr<=0) __input.eof=true;
+        else __input.end+=nr;
+    }
+}
+
+//each [-j K] [-k] [-a file] cmd ... {} ...: run cmd once for each line of stdin or file
+//the line replaces the tokens that are {} as a whole. -k keeps the output in the order of the lines
+#define EACH_ITEM "{}"
+
+struct each_slot {
+    struct task *task;      //NULL if it cannot start
+    int index;              //of the item
+    int out, err;           //buffers of the output with -k, -1 otherwise
+    bool used;
+};
+
+//report the failure of the item, and count it
+static void check_item(struct each_slot *slot, int *nr_failed, int *nr_timed_out)
+{
+    struct task *task=slot->task;
+    int status=task ? task->status : 0;
+
+    if(task && task->timed_out) (*nr_timed_out)++;
+    if(task && !task->timed_out && WIFEXITED(status) && !WEXITSTATUS(status)) return;
+
+    if((*nr_failed)++ >= PFOR_MAX_FAILURES) return;
+    if(!task)
+        fprintf(stderr, "each: #%d cannot start\n", slot->index);
+    else if(task->timed_out)
+        fprintf(stderr, "each: #%d timed out\n", slot->index);
+    else if(task->over_limit)
+        fprintf(stderr, "each: #%d is over a limit\n", slot->index);
+    else if(WIFSIGNALED(status))
+        fprintf(stderr, "each: #%d killed by %s\n", slot->index, strsignal(WTERMSIG(status)));
+    else
+        fprintf(stderr, "each: #%d exited with %d\n", slot->index, WEXITSTATUS(status));
+}
+
+//copy the buffered output of an item to fd, and drop the buffer
+static void flush_output(int buf, int fd)
+{
+    struct stat st;
+    off_t offset=0;
+
+    if(buf<0) return;
+    if(fstat(buf, &st) == 0){
+        while(offset < st.st_size){
+            ssize_t len=sendfile(fd, buf, &offset, st.st_size-offset);
+
+            if(len<0 && errno == EINVAL){
+                //some fds cannot take sendfile(). Copy the rest by hand
+                char chunk[4096];
+
+                while((len=pread(buf, chunk, sizeof(chunk), offset)) > 0){
+                    if(write(fd, chunk, len) != len){
+                        len=-1;
+                        break;
+                    }
+                    offset+=len;
+                }
+            }
+            if(len<=0) break;
+        }
+    }
+    close(buf);
+}
+
+static void run_each(int nr_tokens, char *tokens[])
+{
+    int nr_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool keep_order=false;
+    char *file=NULL;
+    FILE *input=NULL;       //stdin of the shell without -a
+    char *argv[MAX_NR_TOKENS];
+    int items[MAX_NR_TOKENS], nr_items=0, nr_args;
+    int first=1;
+    struct each_slot *slots;
+    char *line=NULL;
+    size_t size=0;
+    int next=0, retired=0, nr_used=0, nr_failed=0, nr_timed_out=0;
+    bool eof=false;
+    int null=-1;
+    struct timespec start, end;
+
+    //options come before the command
+    while(first < nr_tokens && tokens[first][0] == '-'){
+        if(strcmp(tokens[first], "-j") == 0 && first+1 < nr_tokens){
+            nr_jobs=atoi(tokens[++first]);
+        }
+        else if(strcmp(tokens[first], "-a") == 0 && first+1 < nr_tokens){
+            file=tokens[++first];
+        }
+        else if(strcmp(tokens[first], "-k") == 0){
+            keep_order=true;
+        }
+        else break;
+        first++;
+    }
+    if(first >= nr_tokens){
+        fprintf(stderr, "Usage: each [-j K] [-k] [-a file] command [{}]\n");
+        return;
+    }
+    if(nr_jobs<=0) nr_jobs=1;
+
+    //point {} to the item in place. The item goes last without {}
+    nr_args=nr_tokens-first;
+    for(int i=0;i<nr_args;i++){
+        argv[i]=tokens[first+i];
+        if(strcmp(argv[i], EACH_ITEM) == 0) items[nr_items++]=i;
+    }
+    if(nr_items == 0){
+        if(nr_args+1 >= MAX_NR_TOKENS){
+            fprintf(stderr, "each: too many arguments\n");
+            return;
+        }
+        items[nr_items++]=nr_args++;
+    }
+    argv[nr_args]=NULL;
+
+    if(file){
+        input=fopen(file, "r");
+        if(!input){
+            fprintf(stderr, "each: %s: %s\n", file, strerror(errno));
+            return;
+        }
+    }
+    else {
+        //as xargs does, keep the commands from eating the items
+        null=open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+    slots=calloc(nr_jobs, sizeof(*slots));
+    if(!slots){
+        fprintf(stderr, "each: %s\n", strerror(ENOMEM));
+        goto out;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(;;){
+        //keep K items in flight. The line is reused once the item is started
+        while(!eof && nr_used < nr_jobs){
+            struct launch_attr attr = LAUNCH_ATTR_INIT;
+            struct each_slot *slot=slots;
+            ssize_t len=input ? getline(&line, &size, input) : read_input(&line, &size);
+
+            if(len<0){
+                eof=true;
+                break;
+            }
+            if(len && line[len-1] == '\n') line[--len]='\0';
+            if(len == 0) continue;
+
+            while(slot->used) slot++;
+            *slot=(struct each_slot){ .index=next++, .out=-1, .err=-1, .used=true };
+            nr_used++;
+            attr.fds[0]=null;
+
+            if(keep_order){
+                slot->out=memfd_create("each.out", MFD_CLOEXEC);
+                slot->err=memfd_create("each.err", MFD_CLOEXEC);
+                attr.fds[1]=slot->out;
+                attr.fds[2]=slot->err;
+            }
+            for(int i=0;i<nr_items;i++) argv[items[i]]=line;
+            slot->task=start_external(nr_args, argv, &attr);
+        }
+
+        //retire the items done. In the order of the items with -k
+        for(bool progress=true; progress; ){
+            progress=false;
+            for(int i=0;i<nr_jobs;i++){
+                struct each_slot *slot=slots+i;
+
+                if(!slot->used || (slot->task && slot->task->nr_running)) continue;
+                if(keep_order && slot->index != retired) continue;
+
+                flush_output(slot->out, STDOUT_FILENO);
+                flush_output(slot->err, STDERR_FILENO);
+                check_item(slot, &nr_failed, &nr_timed_out);
+                if(slot->task) free_task(slot->task);
+                slot->used=false;
+                nr_used--;
+                retired++;
+                progress=true;
+            }
+        }
+        if(nr_used == 0){
+            if(eof) break;
+            continue;
+        }
+        //fill the free slots first
+        if(!eof && nr_used < nr_jobs) continue;
+        wait_events();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    fprintf(stderr, "each: %d item%s with %d at once, %d failed (%d timed out) in %.3f seconds\n",
+            next, next >= 2 ? "s" : "", nr_jobs, nr_failed, nr_timed_out,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    free(line);
+    free(slots);
+out:
+    if(null>=0) close(null);
+    if(file) fclose(input);
+}
+
+//memo cmd ...: replay the output of cmd cached for the same tokens, cwd, and files
+//memo: print the hits and misses, memo -s MiB: limit the cache, memo -c: clear it
+static void run_memo(int nr_tokens, char *tokens[])
+{
+    struct launch_attr attr = LAUNCH_ATTR_INIT;
+    struct memo_key key;
+    char *argv[MAX_NR_TOKENS];
+    int fds[3] = REDIRECT_INIT;
+    int out, err, null=-1, nr_args, ret;
+    struct task *task;
+
+    if(nr_tokens == 1){
+        memo_print();
+        return;
+    }
+    if(strcmp(tokens[1], "-c") == 0){
+        memo_flush();
+        return;
+    }
+    if(strcmp(tokens[1], "-s") == 0){
+        if(nr_tokens != 3 || atol(tokens[2]) <= 0)
+            fprintf(stderr, "Usage: memo [-s MiB | -c | command]\n");
+        else
+            memo_set_limit((unsigned long)atol(tokens[2]) << 20);
+        return;
+    }
+    if(is_pipeline(nr_tokens-1, tokens+1)){
+        fprintf(stderr, "memo: pipelines are not cached\n");
+        return;
+    }
+
+    nr_args=redirect(nr_tokens-1, tokens+1, argv, fds);
+    if(nr_args<=0){
+        if(nr_args==0) redirect_close(fds);
+        return;
+    }
+    //the shell's stdin is not the same every time. Only a file is
+    if(fds[0]<0) null=open("/dev/null", O_RDONLY | O_CLOEXEC);
+    out=fds[1]>=0 ? fds[1] : STDOUT_FILENO;
+    err=fds[2]>=0 ? fds[2] : STDERR_FILENO;
+
+    ret=memo_key(&key, nr_tokens-1, tokens+1, argv, fds[0]);
+    if(ret){
+        fprintf(stderr, "memo: %s\n", strerror(-ret));
+        goto out;
+    }
+
+    //a hit is written out without forking
+    fflush(stdout);
+    fflush(stderr);
+    ret=memo_replay(&key, out, err);
+    if(ret>=0) goto out_key;
+    if(ret!=-ENOENT) fprintf(stderr, "memo: %s\n", strerror(-ret));
+
+    attr.fds[0]=fds[0]>=0 ? fds[0] : null;
+    attr.fds[1]=memfd_create("memo.out", MFD_CLOEXEC);
+    attr.fds[2]=memfd_create("memo.err", MFD_CLOEXEC);
+    if(attr.fds[1]<0 || attr.fds[2]<0){
+        fprintf(stderr, "memo: %s\n", strerror(errno));
+        if(attr.fds[1]>=0) close(attr.fds[1]);
+        if(attr.fds[2]>=0) close(attr.fds[2]);
+        goto out_key;
     }
 
-    else if(strncmp(tokens[0], "timeout", strlen("timeout")) == 0) {
+    task=start_external(nr_args, argv, &attr);
+    if(task){
+        wait_task(task, true);
+        //what is cut short may not be the same next time
+        if(!task->timed_out && !task->over_limit && WIFEXITED(task->status))
+            memo_store(&key, task->status, attr.fds[1], attr.fds[2]);
+        free_task(task);
+    }
+    flush_output(attr.fds[1], out);
+    flush_output(attr.fds[2], err);
+
+out_key:
+    memo_key_free(&key);
+out:
+    if(null>=0) close(null);
+    redirect_close(fds);
+}
+
+//builtins in the order they are matched; anything else is external
+enum builtin {
+    BUILTIN_EXIT,
+    BUILTIN_PROMPT,
+    BUILTIN_TIMEOUT,
+    BUILTIN_TIME,
+    BUILTIN_FOR,
+    BUILTIN_PFOR,
+    BUILTIN_EACH,
+    BUILTIN_LIMIT,
+    BUILTIN_MEMO,
+    BUILTIN_PIPELINE,
+    BUILTIN_JOBS,
+    BUILTIN_WAIT,
+    BUILTIN_FG,
+    BUILTIN_LAUNCHER,
+    BUILTIN_HASH,
+    BUILTIN_CD,
+    BUILTIN_EXTERNAL,
+};
+
+//find the builtin to run tokens. for and time run the tokens from body in turn
+static int resolve_builtin(int nr_tokens, char * const tokens[], int *body, int *count)
+{
+    if (strncmp(tokens[0], "exit", strlen("exit")) == 0) return BUILTIN_EXIT;
+    if (strncmp(tokens[0], "prompt", strlen("prompt")) == 0) return BUILTIN_PROMPT;
+    if(strncmp(tokens[0], "timeout", strlen("timeout")) == 0) return BUILTIN_TIMEOUT;
+    if(strcmp(tokens[0], "time") == 0) {
+        *body=1;
+        *count=1;
+        return BUILTIN_TIME;
+    }
+    if(strncmp(tokens[0], "for", strlen("for")) == 0) {
+        *body=2;
+        *count=nr_tokens > 1 ? atoi(tokens[1]) : 0;
+        return BUILTIN_FOR;
+    }
+    if(strcmp(tokens[0], "pfor") == 0) return BUILTIN_PFOR;
+    if(strcmp(tokens[0], "each") == 0) return BUILTIN_EACH;
+    if(strcmp(tokens[0], "limit") == 0 || strcmp(tokens[0], "affinity") == 0) {
+        struct launch_limits limits={ 0 };
+        int first=parse_limits(nr_tokens, tokens, &limits);
+
+        *body=first<nr_tokens ? first : 0;
+        *count=1;
+        return BUILTIN_LIMIT;
+    }
+    if(strcmp(tokens[0], "memo") == 0) return BUILTIN_MEMO;
+    //pipeline: a | b | c
+    if(is_pipeline(nr_tokens, (char **)tokens)) return BUILTIN_PIPELINE;
+    if(strcmp(tokens[0], "jobs") == 0) return BUILTIN_JOBS;
+    if(strcmp(tokens[0], "wait") == 0) return BUILTIN_WAIT;
+    if(strcmp(tokens[0], "fg") == 0) return BUILTIN_FG;
+    if(strcmp(tokens[0], "launcher") == 0) return BUILTIN_LAUNCHER;
+    if(strcmp(tokens[0], "hash") == 0) return BUILTIN_HASH;
+    if(strncmp(tokens[0], "cd", strlen("cd")) == 0) return BUILTIN_CD;
+    return BUILTIN_EXTERNAL;
+}
+
+static int run_command(int nr_tokens, char *tokens[]);
+
+//run the builtin resolved for tokens. for is up to the caller
+static int run_builtin(int builtin, int nr_tokens, char *tokens[])
+{
+    double start=trace_now();
+
+    switch(builtin){
+    case BUILTIN_EXIT:
+        return 0;
+
+    case BUILTIN_PROMPT:
+        strcpy(__prompt, tokens[1]);
+        break;
+
+    case BUILTIN_TIMEOUT:
         if(nr_tokens !=  1){
-             set_timeout(atoi(tokens[1]));
+             set_timeout(parse_timeout(tokens[1]));
         }
         else{
-            fprintf(stderr, "Current timeout is %d second\n", __timeout);
+            fprintf(stderr, "Current timeout is %g second\n", __timeout / 1000.0);
         }
-    }
-    
-    else if(strncmp(tokens[0], "for", strlen("for")) == 0) {
-        for(int i=0;i<atoi(tokens[1]);i++){
-            //for, num
-            run_command(nr_tokens-2, tokens+2);
+        break;
+
+    case BUILTIN_PFOR:
+        run_pfor(nr_tokens, tokens);
+        break;
+
+    case BUILTIN_EACH:
+        run_each(nr_tokens, tokens);
+        break;
+
+    case BUILTIN_MEMO:
+        run_memo(nr_tokens, tokens);
+        break;
+
+    case BUILTIN_JOBS:
+        print_jobs();
+        break;
+
+    case BUILTIN_WAIT:
+        if(wait_jobs(tokens[1]) < 0){
+            fprintf(stderr, "wait: %s: no such job\n", tokens[1]);
+        }
+        break;
+
+    case BUILTIN_FG: {
+        //wait for the job in the foreground. Its timer keeps running
+        struct task *task=take_job(tokens[1]);
+        if(!task){
+            fprintf(stderr, "fg: %s: no such job\n", tokens[1] ? tokens[1] : "current");
         }
+        else {
+            wait_task(task, true);
+            free_task(task);
+        }
+        break;
     }
 
-    else if(strncmp(tokens[0], "cd", strlen("cd")) == 0) {
+    case BUILTIN_LAUNCHER:
+        //select how to start external commands; fork, vfork, spawn, or zygote
+        if(nr_tokens == 1){
+            fprintf(stderr, "Current launcher is %s\n", launcher_name(launcher));
+        }
+        else if(set_launcher(tokens[1]) < 0){
+            fprintf(stderr, "Unknown launcher %s\n", tokens[1]);
+        }
+        break;
+
+    case BUILTIN_HASH:
+        //hash: list the cached paths, hash -r: forget them all
+        if(nr_tokens == 1){
+            path_print();
+        }
+        else if(strcmp(tokens[1], "-r") == 0){
+            path_flush();
+        }
+        else {
+            for(int i=1;i<nr_tokens;i++){
+                if(!path_lookup(tokens[i])){
+                    fprintf(stderr, "hash: %s: not found\n", tokens[i]);
+                }
+            }
+        }
+        break;
+
+    case BUILTIN_CD: {
 	char*dir = tokens[1];
         if(strcmp(dir,"~")==0){
             chdir(getenv("HOME"));
@@ -115,37 +910,346 @@ static int run_command(int nr_tokens, char *tokens[])
         else{
             chdir(dir);
         }
+        break;
+    }
+
+    //execute any external command or the pipeline
+    default:
+        run_external(nr_tokens, tokens);
+        break;
+    }
+
+    trace_span(builtin == BUILTIN_EXTERNAL || builtin == BUILTIN_PIPELINE ? "external" : "builtin",
+            tokens[0], start, 0, NULL, 0);
+    return 1;
+}
+
+//$(command ...): the words the command writes to stdout take the place of it.
+//it may span tokens, and may have text around it in the token, like $(pwd)/file
+#define SUBST_CHUNK (64 << 10)    //the first size of the buffer, doubled as needed
+#define MAX_SUBST_BUFS (MAX_NR_TOKENS * 3)
+
+static bool has_subst(int nr_tokens, char * const tokens[])
+{
+    for(int i=0;i<nr_tokens;i++){
+        if(strstr(tokens[i], "$(")) return true;
+    }
+    return false;
+}
+
+//read fd to the end into buf of size, growing it. Return the length or -errno
+static ssize_t read_all(int fd, char **buf, size_t *size, bool timed)
+{
+    size_t len=0;
+
+    for(;;){
+        ssize_t ret;
+
+        if(len == *size){
+            char *more=realloc(*buf, *size*2+1);
+
+            if(!more) return -ENOMEM;
+            *buf=more;
+            *size*=2;
+        }
+        //keep timing the command while it writes
+        if(timed) wait_readable(fd);
+        ret=read(fd, *buf+len, *size-len);
+        if(ret<0 && errno == EINTR) continue;
+        if(ret<0) return -errno;
+        if(ret == 0) return len;
+        len+=ret;
+    }
+}
+
+//run the command, and return what it writes to stdout. The caller frees it
+static char *capture(int nr_tokens, char *tokens[])
+{
+    int builtin, body=0, count=0;
+    size_t size=SUBST_CHUNK;
+    char *buf=malloc(size+1);
+    ssize_t len=-ENOMEM;
+
+    if(!buf) goto out;
+
+    builtin=resolve_builtin(nr_tokens, tokens, &body, &count);
+    if((builtin == BUILTIN_EXTERNAL || builtin == BUILTIN_PIPELINE) && !has_subst(nr_tokens, tokens)){
+        //read through a pipe as the command writes, in reads as big as the buffer has room for
+        struct launch_attr attr = LAUNCH_ATTR_INIT;
+        struct task *task;
+        int pipefd[2];
+
+        if(pipe2(pipefd, O_CLOEXEC)){
+            len=-errno;
+            goto out;
+        }
+        fcntl(pipefd[1], F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+        attr.fds[1]=pipefd[1];
+        task=start_external(nr_tokens, tokens, &attr);
+        close(pipefd[1]);
+
+        len=read_all(pipefd[0], &buf, &size, true);
+        close(pipefd[0]);
+        if(task){
+            wait_task(task, true);
+            free_task(task);
+        }
     }
-    
-    //execute any external command
     else {
-        int wstatus;
-        cpid=fork();
-        name=tokens[0];
-
-        if(cpid==0){
-	    //child
-            int execvp_value= execvp(tokens[0], tokens);
-            //if this has error, it has a return value
-            if(execvp_value<0){
-		close(0);
-                fprintf(stderr, "No such file or directory\n");
-                exit(0);
+        //builtins write to the stdout of the shell itself. Point it to a memfd
+        //for a while, which never blocks them however much they write
+        int out=memfd_create("subst", MFD_CLOEXEC);
+        int saved=fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+
+        if(out<0 || saved<0){
+            len=-errno;
+            if(out>=0) close(out);
+            if(saved>=0) close(saved);
+            goto out;
+        }
+        fflush(stdout);
+        dup2(out, STDOUT_FILENO);
+        run_command(nr_tokens, tokens);
+        fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+
+        lseek(out, 0, SEEK_SET);
+        len=read_all(out, &buf, &size, false);
+        close(out);
+    }
+
+out:
+    if(len<0){
+        fprintf(stderr, "$(%s): %s\n", tokens[0], strerror(-len));
+        free(buf);
+        return NULL;
+    }
+    buf[len]='\0';
+    return buf;
+}
+
+//copy the command in $(...) starting at tokens[first]+2 to inner, and find the ) closing it.
+//Return the index of the token with the ), or -1
+static int find_subst(int nr_tokens, char *tokens[], int first, char *inner, char **close)
+{
+    int depth=1, len=0;
+
+    for(int i=first;i<nr_tokens;i++){
+        char *start=(i == first) ? strstr(tokens[i], "$(")+2 : tokens[i];
+        char *p=start;
+        bool quote;
+
+        *close=NULL;
+        for(; *p; p++){
+            if(*p == '(') depth++;
+            else if(*p == ')' && --depth == 0){
+                *close=p;
+                break;
             }
-       }
-
-       else if(cpid>0){
-        //parent
-	sigaction(SIGALRM,&sa,&old_sa);
-	alarm(__timeout);
-	pid_t wait_id = waitpid(cpid,&wstatus,0);
-	if(wait_id != -1) {
-		alarm(0);
-	}
-      }
+        }
+        //a token after the first may have been quoted, like $(grep "a b" file)
+        quote=i != first && strpbrk(start, " \t") != NULL;
+        len+=snprintf(inner+len, MAX_COMMAND_LEN-len, "%s%s%.*s%s", i == first ? "" : " ",
+                quote ? "\"" : "", (int)(p-start), start, quote ? "\"" : "");
+        if(len >= MAX_COMMAND_LEN) return -1;
+        if(*close) return i;
     }
+    return -1;
+}
 
-    return 1;
+//replace $(...) in tokens with the words the commands write, into expanded.
+//the words are in bufs to free. Return the number of tokens expanded, or -1
+static int expand_command(int nr_tokens, char *tokens[], char *expanded[], char *bufs[], int *nr_bufs)
+{
+    int nr=0;
+
+    for(int i=0;i<nr_tokens;i++){
+        char inner[MAX_COMMAND_LEN];
+        char *inner_tokens[MAX_NR_TOKENS] = { NULL };
+        char *words[MAX_NR_TOKENS];
+        char *start=strstr(tokens[i], "$(");
+        char *close, *out=NULL, *word, *save;
+        int nr_inner=0, nr_words=0, last, prefix;
+
+        if(!start){
+            if(nr == MAX_NR_TOKENS-1) goto too_many;
+            expanded[nr++]=tokens[i];
+            continue;
+        }
+
+        last=find_subst(nr_tokens, tokens, i, inner, &close);
+        if(last<0){
+            fprintf(stderr, "Syntax error near unmatched $(\n");
+            return -1;
+        }
+        if(parse_command(inner, &nr_inner, inner_tokens)){
+            out=capture(nr_inner, inner_tokens);
+            if(!out) return -1;
+            bufs[(*nr_bufs)++]=out;
+        }
+
+        //trailing newlines are trimmed, and the rest is split into words
+        if(out){
+            size_t len=strlen(out);
+
+            while(len && out[len-1] == '\n') out[--len]='\0';
+            for(word=strtok_r(out, " \t\n", &save); word; word=strtok_r(NULL, " \t\n", &save)){
+                if(nr+nr_words == MAX_NR_TOKENS-1) goto too_many;
+                words[nr_words++]=word;
+            }
+        }
+
+        //glue the text around $(...) to the first and the last words
+        prefix=start-tokens[i];
+        if(nr_words == 0 && (prefix || close[1])) words[nr_words++]="";
+        if(prefix && asprintf(&word, "%.*s%s", prefix, tokens[i], words[0]) >= 0){
+            bufs[(*nr_bufs)++]=word;
+            words[0]=word;
+        }
+        if(close[1] && asprintf(&word, "%s%s", words[nr_words-1], close+1) >= 0){
+            bufs[(*nr_bufs)++]=word;
+            words[nr_words-1]=word;
+        }
+
+        memcpy(expanded+nr, words, sizeof(*words)*nr_words);
+        nr+=nr_words;
+        i=last;
+    }
+    expanded[nr]=NULL;
+    return nr;
+
+too_many:
+    fprintf(stderr, "Too many tokens in $(...)\n");
+    return -1;
+}
+
+//run the builtin resolved for tokens once $(...) in them are expanded
+static int run_expanded(int builtin, int nr_tokens, char *tokens[])
+{
+    char *expanded[MAX_NR_TOKENS];
+    char *bufs[MAX_SUBST_BUFS];
+    int nr_bufs=0, nr, ret=1, body=0, count=0;
+
+    if(!has_subst(nr_tokens, tokens)) return run_builtin(builtin, nr_tokens, tokens);
+
+    nr=expand_command(nr_tokens, tokens, expanded, bufs, &nr_bufs);
+    if(nr>0){
+        builtin=resolve_builtin(nr, expanded, &body, &count);
+        if(builtin == BUILTIN_FOR || builtin == BUILTIN_TIME || builtin == BUILTIN_LIMIT)
+            ret=run_command(nr, expanded);
+        else
+            ret=run_builtin(builtin, nr, expanded);
+    }
+
+    for(int i=0;i<nr_bufs;i++) free(bufs[i]);
+    return ret;
+}
+
+static int run_command(int nr_tokens, char *tokens[])
+{
+    /* This function is all yours. Good luck! */
+    int builtin, body=0, count=0;
+    struct usage mark;
+
+    //report the background jobs done since the last command
+    reap_jobs();
+
+    builtin=resolve_builtin(nr_tokens, tokens, &body, &count);
+    if(builtin == BUILTIN_FOR) {
+        for(int i=0;i<count;i++){
+            double start=trace_now();
+
+            //for, num
+            run_command(nr_tokens-2, tokens+2);
+            trace_span("for", "for", start, 0, "iteration", i);
+        }
+        return 1;
+    }
+    if(builtin == BUILTIN_LIMIT) {
+        struct launch_limits saved=__limits;
+        int first=set_limits(nr_tokens, tokens);
+
+        if(first>0){
+            run_command(nr_tokens-first, tokens+first);
+            __limits=saved;     //for the command only
+        }
+        return 1;
+    }
+    if(builtin == BUILTIN_TIME) {
+        if(nr_tokens == 1){
+            fprintf(stderr, "Usage: time command\n");
+            return 1;
+        }
+        usage_mark(&mark);
+        run_command(nr_tokens-1, tokens+1);
+        usage_report(tokens[1], &mark);
+        return 1;
+    }
+    return run_expanded(builtin, nr_tokens, tokens);
+}
+
+//run the command compiled by load_script(). Same as run_command() without parsing
+static int exec_command(struct command *cmd)
+{
+    struct usage mark;
+
+    reap_jobs();
+
+    if(cmd->builtin == BUILTIN_FOR) {
+        for(int i=0;i<cmd->count && cmd->body;i++){
+            double start=trace_now();
+
+            exec_command(cmd->body);
+            trace_span("for", "for", start, 0, "iteration", i);
+        }
+        return 1;
+    }
+    if(cmd->builtin == BUILTIN_LIMIT) {
+        struct launch_limits saved=__limits;
+
+        if(set_limits(cmd->nr_tokens, cmd->tokens)>0 && cmd->body){
+            exec_command(cmd->body);
+            __limits=saved;     //for the command only
+        }
+        return 1;
+    }
+    if(cmd->builtin == BUILTIN_TIME) {
+        if(!cmd->body){
+            fprintf(stderr, "Usage: time command\n");
+            return 1;
+        }
+        usage_mark(&mark);
+        exec_command(cmd->body);
+        usage_report(cmd->tokens[1], &mark);
+        return 1;
+    }
+    return run_expanded(cmd->builtin, cmd->nr_tokens, cmd->tokens);
+}
+
+//mysh -f script: compile the whole script first, and then run it
+static int run_script(const char *filename)
+{
+    static const struct script_ops ops = {
+        .resolve = resolve_builtin,
+    };
+    struct script script;
+    int ret;
+
+    ret=load_script(filename, &ops, &script);
+    if(ret){
+        fprintf(stderr, "%s: %s\n", filename, strerror(-ret));
+        return ret;
+    }
+
+    for(int i=0;i<script.nr_lines;i++){
+        ret=exec_command(script.lines + i);
+        if(ret == 0) break;
+        else if(ret < 0) fprintf(stderr, "Error in run_command: %d\n", ret);
+    }
+
+    unload_script(&script);
+    return 0;
 }
 
 
@@ -162,7 +1266,13 @@ static int run_command(int nr_tokens, char *tokens[])
  */
 static int initialize(int argc, char * const argv[])
 {
-	return 0;
+	char *backend = getenv("MYSH_LAUNCHER");
+
+	if (backend && set_launcher(backend) < 0) {
+		fprintf(stderr, "Unknown launcher %s\n", backend);
+		return -1;
+	}
+	return supervisor_init();
 }
 
 
@@ -175,16 +1285,42 @@ static int initialize(int argc, char * const argv[])
  */
 static void finalize(int argc, char * const argv[])
 {
-
+	jobs_fini();
+	zygote_stop();
+	supervisor_fini();
+	stats_fini();
+	trace_fini();
 }
 
 
-/*====================================================================*/
-/*          ****** DO NOT MODIFY ANYTHING BELOW THIS LINE ******      */
+/***********************************************************************
+ * read_command()
+ *
+ * DESCRIPTION
+ *   Take the next command from stdin like fgets(), supervising the timed
+ *   children while waiting for it. A line longer than @size is cut.
+ */
+static char *read_command(char *command, int size)
+{
+	static char *line = NULL;
+	static size_t line_size = 0;
+	ssize_t len = read_input(&line, &line_size);
+
+	if (len < 0) return NULL;
+	if (len >= size) len = size - 1;
+
+	memcpy(command, line, len);
+	command[len] = '\0';
+	return command;
+}
+
 
 static bool __verbose = true;
 static char *__color_start = "[0;31;40m";
 static char *__color_end = "[0m";
+static char *__script = NULL;
+static bool __stats = false;
+static char *__trace = NULL;
 
 /***********************************************************************
  * main() of this program.
@@ -195,7 +1331,7 @@ int main(int argc, char * const argv[])
 	int ret = 0;
 	int opt;
 
-	while ((opt = getopt(argc, argv, "qm")) != -1) {
+	while ((opt = getopt(argc, argv, "qmf:sT:")) != -1) {
 		switch (opt) {
 		case 'q':
 			__verbose = false;
@@ -203,15 +1339,32 @@ int main(int argc, char * const argv[])
 		case 'm':
 			__color_start = __color_end = "\0";
 			break;
+		case 'f':
+			__script = optarg;
+			break;
+		case 's':
+			__stats = true;
+			break;
+		case 'T':
+			__trace = optarg;
+			break;
 		}
 	}
 
 	if ((ret = initialize(argc, argv))) return EXIT_FAILURE;
+	if (__stats && stats_init()) return EXIT_FAILURE;
+	if (__trace && trace_init(__trace)) return EXIT_FAILURE;
+
+	if (__script) {
+		ret = run_script(__script);
+		finalize(argc, argv);
+		return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
 
 	if (__verbose)
 		fprintf(stderr, "%s%s%s ", __color_start, __prompt, __color_end);
 
-	while (fgets(command, sizeof(command), stdin)) {	
+	while (read_command(command, sizeof(command))) {	
 		char *tokens[MAX_NR_TOKENS] = { NULL };
 		int nr_tokens = 0;
 
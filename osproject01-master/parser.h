@@ -39,6 +39,11 @@
  *    tokens[3] = "/path/to/dest"
  *    tokens[>=4] = NULL
  *
+ *  A string quoted with double quotation marks (") can contain whitespaces in a
+ *  token, as of PA0. For example, 'echo "hello  world"' is split into "echo"
+ *  and "hello  world".
+ *
+ *  The tokens are split by the engines in libtoken in place; see tokenizer.h.
  *
  * RETURN VALUE
  *  Return 1 if @nr_tokens > 0
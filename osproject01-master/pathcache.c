@@ -0,0 +1,203 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "pathcache.h"
+
+/**
+ * Command names are interned, and the ID of each name indexes @paths and
+ * @hits. An atom stays even when its path is forgotten, so the ID can be
+ * reused when the command is found again.
+ */
+static struct {
+	bool initialized;
+	char *path_env;			/* PATH the entries are resolved with */
+	struct tok_intern names;
+	char **paths;
+	unsigned long *hits;
+	unsigned int nr_entries;
+	char *relative;			/* Last found in a relative directory */
+} __cache;
+
+static bool __is_executable(const char *path)
+{
+	struct stat st;
+
+	return access(path, X_OK) == 0 && stat(path, &st) == 0 &&
+			S_ISREG(st.st_mode);
+}
+
+/**
+ * Search PATH for @name as execvp() does. An empty directory in PATH means
+ * the current directory. @relative is set if found in a relative directory.
+ */
+static char *__search(const char *name, const char *path_env, bool *relative)
+{
+	size_t len = strlen(name);
+	const char *dir = path_env;
+
+	while (dir) {
+		const char *end = strchr(dir, ':');
+		size_t dir_len = end ? end - dir : strlen(dir);
+		char *path = malloc(dir_len + len + 3);
+
+		if (!path) return NULL;
+
+		if (dir_len) {
+			memcpy(path, dir, dir_len);
+		} else {
+			path[0] = '.';
+			dir_len = 1;
+		}
+		path[dir_len] = '/';
+		memcpy(path + dir_len + 1, name, len + 1);
+
+		if (__is_executable(path)) {
+			*relative = path[0] != '/';
+			return path;
+		}
+		free(path);
+
+		dir = end ? end + 1 : NULL;
+	}
+	return NULL;
+}
+
+void path_flush(void)
+{
+	if (!__cache.initialized) return;
+
+	for (unsigned int i = 0; i < __cache.nr_entries; i++) {
+		free(__cache.paths[i]);
+	}
+	free(__cache.paths);
+	free(__cache.hits);
+	free(__cache.path_env);
+	free(__cache.relative);
+	tok_intern_fini(&__cache.names);
+
+	__cache.relative = NULL;
+	__cache.paths = NULL;
+	__cache.hits = NULL;
+	__cache.path_env = NULL;
+	__cache.nr_entries = 0;
+	__cache.initialized = false;
+}
+
+static bool __validate(const char *path_env)
+{
+	/* Changing PATH invalidates every entry */
+	if (__cache.initialized && strcmp(__cache.path_env, path_env) != 0) {
+		path_flush();
+	}
+	if (__cache.initialized) return true;
+
+	if (tok_intern_init(&__cache.names)) return false;
+	__cache.path_env = strdup(path_env);
+	if (!__cache.path_env) {
+		tok_intern_fini(&__cache.names);
+		return false;
+	}
+	__cache.initialized = true;
+	return true;
+}
+
+const char *path_lookup(const char *name)
+{
+	const char *path_env = getenv("PATH");
+	const struct tok_atom *atom;
+	unsigned int id;
+
+	if (strchr(name, '/')) return name;
+
+	/* execvp() searches the default path without PATH */
+	if (!path_env) path_env = "/bin:/usr/bin";
+
+	if (!__validate(path_env)) return NULL;
+
+	atom = tok_intern(&__cache.names, name, strlen(name));
+	if (!atom) return NULL;
+	id = atom->id;
+
+	if (id >= __cache.nr_entries) {
+		unsigned int nr = __cache.names.max_atoms;
+		char **paths = realloc(__cache.paths, sizeof(*paths) * nr);
+		unsigned long *hits;
+
+		if (!paths) return NULL;
+		__cache.paths = paths;
+
+		hits = realloc(__cache.hits, sizeof(*hits) * nr);
+		if (!hits) return NULL;
+		__cache.hits = hits;
+
+		for (unsigned int i = __cache.nr_entries; i < nr; i++) {
+			__cache.paths[i] = NULL;
+			__cache.hits[i] = 0;
+		}
+		__cache.nr_entries = nr;
+	}
+
+	if (!__cache.paths[id]) {
+		bool relative = false;
+		char *path = __search(name, path_env, &relative);
+
+		if (!path) return NULL;
+
+		/* It is another file, or none, once the shell changes the directory */
+		if (relative) {
+			free(__cache.relative);
+			__cache.relative = path;
+			return path;
+		}
+		__cache.paths[id] = path;
+		__cache.hits[id] = 0;
+	}
+	__cache.hits[id]++;
+	return __cache.paths[id];
+}
+
+void path_forget(const char *name)
+{
+	const struct tok_atom *atom;
+
+	if (!__cache.initialized) return;
+
+	atom = tok_intern_find(&__cache.names, name, strlen(name));
+	if (!atom || atom->id >= __cache.nr_entries) return;
+
+	free(__cache.paths[atom->id]);
+	__cache.paths[atom->id] = NULL;
+}
+
+void path_print(void)
+{
+	bool empty = true;
+
+	for (unsigned int i = 0; i < __cache.nr_entries; i++) {
+		if (!__cache.paths[i]) continue;
+		if (empty) printf("hits\tcommand\n");
+		printf("%4lu\t%s\n", __cache.hits[i], __cache.paths[i]);
+		empty = false;
+	}
+	if (empty) printf("hash table empty\n");
+}
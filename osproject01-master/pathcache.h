@@ -0,0 +1,57 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __PATHCACHE_H__
+#define __PATHCACHE_H__
+
+/**
+ * Cache of the command names to their absolute paths, like the hash builtin
+ * of other shells. Commands are searched in PATH on their first use only and
+ * started with execv() after then, so running the same command again does
+ * not try every directory in PATH.
+ *
+ * Entries are added lazily, and all of them are dropped when PATH is changed
+ * or the cache is flushed with "hash -r".
+ */
+
+/***********************************************************************
+ * path_lookup()
+ *
+ * DESCRIPTION
+ *  Find the executable for @name. @name with '/' is used as it is.
+ *
+ * RETURN VALUE
+ *  Return the path to the executable, which is valid until the cache is
+ *  changed. A path found in a relative directory of PATH is not cached, and
+ *  is valid until the next lookup. Return NULL if @name is not found in PATH.
+ */
+const char *path_lookup(const char *name);
+
+/**
+ * Forget the path to @name, e.g., when the cached executable has gone
+ */
+void path_forget(const char *name);
+
+/**
+ * Drop all the cached paths
+ */
+void path_flush(void);
+
+/**
+ * Print the cached paths with the number of hits for each
+ */
+void path_print(void);
+
+#endif
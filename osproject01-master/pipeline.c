@@ -0,0 +1,247 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "launch.h"
+#include "pipeline.h"
+#include "redirect.h"
+
+static inline bool __is_bar(const char *token)
+{
+	return token[0] == '|' && token[1] == '\0';
+}
+
+bool is_pipeline(int nr_tokens, char * const tokens[])
+{
+	for (int i = 0; i < nr_tokens; i++) {
+		if (__is_bar(tokens[i])) return true;
+	}
+	return false;
+}
+
+/**
+ * Move @len bytes from the pipe @in to @out. splice() cannot write to some
+ * files such as the ones opened with O_APPEND on older kernels; copy through
+ * the user space only for them.
+ */
+static int __splice_out(int in, int out, size_t len)
+{
+	char buffer[4096];
+
+	while (len > 0) {
+		ssize_t ret = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE);
+
+		if (ret < 0 && errno == EINTR) continue;
+		if (ret < 0 && errno == EINVAL) break;
+		if (ret <= 0) return ret < 0 ? -errno : -EPIPE;
+		len -= ret;
+	}
+
+	while (len > 0) {
+		ssize_t nr_read = read(in, buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+
+		if (nr_read < 0 && errno == EINTR) continue;
+		if (nr_read <= 0) return nr_read < 0 ? -errno : -EPIPE;
+
+		for (ssize_t done = 0; done < nr_read; ) {
+			ssize_t ret = write(out, buffer + done, nr_read - done);
+
+			if (ret < 0 && errno == EINTR) continue;
+			if (ret < 0) return -errno;
+			done += ret;
+		}
+		len -= nr_read;
+	}
+	return 0;
+}
+
+/**
+ * Relay the pipe @in to @out, and to @file as well if @file >= 0. tee(2)
+ * duplicates the data into another pipe without consuming it, and the data
+ * is then spliced out, so it does not go through the user space. When @out
+ * is not a pipe, the data is teed into a pipe of our own to splice it out.
+ */
+static int __relay(int in, int out, int file)
+{
+	struct stat st;
+	int pipefd[2] = { -1, -1 };
+	int tee_out = out;
+	ssize_t len;
+	int ret = 0;
+
+	if (file < 0) {
+		while ((len = splice(in, NULL, out, NULL, PIPE_BUFFER_SIZE,
+						SPLICE_F_MOVE)) != 0) {
+			if (len < 0 && errno == EINTR) continue;
+			if (len < 0) return -errno;
+		}
+		return 0;
+	}
+
+	if (fstat(out, &st) || !S_ISFIFO(st.st_mode)) {
+		if (pipe2(pipefd, O_CLOEXEC)) return -errno;
+		fcntl(pipefd[1], F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+		tee_out = pipefd[1];
+	}
+
+	while ((len = tee(in, tee_out, PIPE_BUFFER_SIZE, 0)) != 0) {
+		if (len < 0 && errno == EINTR) continue;
+		if (len < 0) {
+			ret = -errno;
+			break;
+		}
+		if (pipefd[0] >= 0 && (ret = __splice_out(pipefd[0], out, len))) break;
+		if ((ret = __splice_out(in, file, len))) break;
+	}
+
+	if (pipefd[0] >= 0) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+	}
+	return ret;
+}
+
+/**
+ * Whether the stage is "tee [-a] [file]" reading from a pipe
+ */
+static bool __is_builtin_tee(char * const argv[], int in)
+{
+	int i = 1;
+
+	if (in < 0 || strcmp(argv[0], "tee") != 0) return false;
+
+	if (argv[i] && strcmp(argv[i], "-a") == 0) i++;
+	if (argv[i] && argv[i][0] == '-') return false;
+	return !argv[i] || !argv[i + 1];
+}
+
+static pid_t __launch_tee(char * const argv[], const struct launch_attr *attr)
+{
+	bool append = argv[1] && strcmp(argv[1], "-a") == 0;
+	char *filename = argv[append ? 2 : 1];
+	pid_t pid;
+
+	/**
+	 * Relay in a child of our own so that the stages around keep running
+	 * while the shell waits for them.
+	 */
+	pid = fork();
+	if (pid == 0) {
+		int file = -1;
+
+		setpgid(0, attr->pgid);
+		for (int i = 0; i < 3; i++) {
+			if (attr->fds[i] >= 0 && attr->fds[i] != i) dup2(attr->fds[i], i);
+		}
+		if (filename) {
+			file = open(filename, O_WRONLY | O_CREAT | O_CLOEXEC |
+					(append ? O_APPEND : O_TRUNC), 0644);
+			if (file < 0) {
+				fprintf(stderr, "tee: %s: %s\n", filename, strerror(errno));
+			}
+		}
+		/* Do not flush the stdio of the shell */
+		_exit(__relay(0, 1, file) ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	if (pid < 0) return -errno;
+
+	setpgid(pid, attr->pgid ? attr->pgid : pid);
+	return pid;
+}
+
+int launch_pipeline(int nr_tokens, char * const tokens[],
+		const struct launch_attr *io, pid_t pids[])
+{
+	char *argv[nr_tokens + 1];
+	int nr_pids = 0;
+	int in = -1;	/* Read end of the pipe from the previous stage */
+	int start = 0;
+
+	for (int i = 0; i <= nr_tokens; i++) {
+		if (i < nr_tokens && !__is_bar(tokens[i])) continue;
+		if (i == start) {
+			fprintf(stderr, "Syntax error near unexpected |\n");
+			return -EINVAL;
+		}
+		start = i + 1;
+	}
+
+	start = 0;
+	for (int i = 0; i <= nr_tokens; i++) {
+		struct launch_attr attr = LAUNCH_ATTR_INIT;
+		int pipefd[2] = { -1, -1 };
+		int fds[3] = REDIRECT_INIT;
+		int nr_args;
+		pid_t pid;
+
+		if (i < nr_tokens && !__is_bar(tokens[i])) continue;
+
+		/* Stages are terminated in our own copy of argv, not in @tokens */
+		nr_args = redirect(i - start, tokens + start, argv + start, fds);
+
+		if (i < nr_tokens) {
+			if (pipe2(pipefd, O_CLOEXEC)) {
+				perror("pipe");
+				break;
+			}
+			/* Larger buffers let the stages run longer without switching */
+			fcntl(pipefd[1], F_SETPIPE_SZ, PIPE_BUFFER_SIZE);
+		}
+
+		/* Redirections take over the pipes as in other shells */
+		attr.fds[0] = fds[0] >= 0 ? fds[0] : in;
+		attr.fds[1] = fds[1] >= 0 ? fds[1] : pipefd[1];
+		attr.fds[2] = fds[2];
+		if (io) {
+			if (start == 0 && fds[0] < 0) attr.fds[0] = io->fds[0];
+			if (i == nr_tokens && fds[1] < 0) attr.fds[1] = io->fds[1];
+			if (fds[2] < 0) attr.fds[2] = io->fds[2];
+			attr.limits = io->limits;
+		}
+		attr.pgid = nr_pids ? pids[0] : 0;	/* The group of the first stage */
+
+		if (nr_args <= 0) {
+			pid = -EINVAL;		/* Reported by redirect() if < 0 */
+		} else if (__is_builtin_tee(argv + start, attr.fds[0] == in ? in : -1)) {
+			pid = __launch_tee(argv + start, &attr);
+		} else {
+			pid = launch_command(argv + start, &attr);
+		}
+		if (pid > 0) {
+			pids[nr_pids++] = pid;
+		} else if (nr_args > 0) {
+			fprintf(stderr, "No such file or directory\n");
+		}
+
+		/* The children have their own copies */
+		redirect_close(fds);
+		if (in >= 0) close(in);
+		if (pipefd[1] >= 0) close(pipefd[1]);
+		in = pipefd[0];
+
+		start = i + 1;
+	}
+	if (in >= 0) close(in);
+
+	return nr_pids;
+}
@@ -0,0 +1,57 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <sys/types.h>
+
+#include "types.h"
+#include "launch.h"
+
+/**
+ * Pipelines; commands separated by "|" as separate tokens, e.g.,
+ *   ./toy arg | grep argv | wc -l
+ *
+ * All the stages start at once, connected with pipes with enlarged buffers.
+ * tee in the middle or at the end of a pipeline is run by the shell, which
+ * relays the data with tee(2) and splice(2) so that it is never copied into
+ * the user space. "tee [-a] [file]" is supported; tee with other options or
+ * more files is run from PATH.
+ */
+#define PIPE_BUFFER_SIZE	(1 << 20)	/* Up to /proc/sys/fs/pipe-max-size */
+
+bool is_pipeline(int nr_tokens, char * const tokens[]);
+
+/***********************************************************************
+ * launch_pipeline()
+ *
+ * DESCRIPTION
+ *  Start the stages of the pipeline in @tokens at once in a process group
+ *  with the limits in @io, and put the pids of the started ones into
+ *  @pids[], which should have room for @nr_tokens. @pids[0] leads the
+ *  process group. The fds in @io are the stdin of the first stage, the
+ *  stdout of the last one, and the stderr of all, unless redirected. @io
+ *  may be NULL. Stages that cannot be started are reported, and the others
+ *  still run.
+ *
+ * RETURN VALUE
+ *  Return the number of children started, or -EINVAL if the pipeline has
+ *  an empty stage.
+ */
+int launch_pipeline(int nr_tokens, char * const tokens[],
+		const struct launch_attr *io, pid_t pids[]);
+
+#endif
@@ -0,0 +1,168 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "redirect.h"
+
+struct operator {
+	const char *str;
+	int fd;					/* To redirect */
+	int flags;				/* To open the file */
+	bool here;				/* The word itself is the input */
+};
+
+/* Longer ones first, so that >> is not taken for > */
+static const struct operator __operators[] = {
+	{ "<<<", 0, 0, true },
+	{ "2>>", 2, O_WRONLY | O_CREAT | O_APPEND },
+	{ "2>", 2, O_WRONLY | O_CREAT | O_TRUNC },
+	{ ">>", 1, O_WRONLY | O_CREAT | O_APPEND },
+	{ ">", 1, O_WRONLY | O_CREAT | O_TRUNC },
+	{ "<", 0, O_RDONLY },
+	{ NULL },
+};
+
+static const struct operator *__match(const char *token)
+{
+	for (const struct operator *op = __operators; op->str; op++) {
+		if (strncmp(token, op->str, strlen(op->str)) == 0) return op;
+	}
+	return NULL;
+}
+
+/**
+ * Parse the size hint like [64M] at @*str, and move @*str past it.
+ * Return -1 if the hint is malformed.
+ */
+static long long __size_hint(char **str)
+{
+	char *end;
+	long long size;
+
+	if (**str != '[') return 0;
+
+	size = strtoll(*str + 1, &end, 10);
+	switch (*end) {
+	case 'G': case 'g':
+		size <<= 10;
+		/* Fall through */
+	case 'M': case 'm':
+		size <<= 10;
+		/* Fall through */
+	case 'K': case 'k':
+		size <<= 10;
+		end++;
+		break;
+	}
+	if (*end != ']' || size < 0) return -1;
+
+	*str = end + 1;
+	return size;
+}
+
+static int __open(const struct operator *op, const char *file, long long size)
+{
+	int fd = open(file, op->flags | O_CLOEXEC, 0644);
+
+	if (fd < 0) return -errno;
+
+	/* Lay out the blocks at once but leave the size as the child writes */
+	if (size > 0) {
+		off_t offset = (op->flags & O_APPEND) ? lseek(fd, 0, SEEK_END) : 0;
+
+		fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, size);
+	}
+	return fd;
+}
+
+/* Feed @word through a pipe. It fits in the buffer of the pipe as a line does */
+static int __here_string(const char *word)
+{
+	size_t len = strlen(word);
+	int pipefd[2];
+
+	if (pipe2(pipefd, O_CLOEXEC)) return -errno;
+
+	if (write(pipefd[1], word, len) != len || write(pipefd[1], "\n", 1) != 1) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return -EPIPE;
+	}
+	close(pipefd[1]);
+	return pipefd[0];
+}
+
+void redirect_close(int fds[3])
+{
+	for (int i = 0; i < 3; i++) {
+		if (fds[i] >= 0) close(fds[i]);
+		fds[i] = -1;
+	}
+}
+
+int redirect(int nr_tokens, char * const tokens[], char *argv[], int fds[3])
+{
+	int nr_args = 0;
+
+	for (int i = 0; i < nr_tokens; i++) {
+		const struct operator *op = __match(tokens[i]);
+		char *target;
+		long long size;
+		int fd;
+
+		if (!op) {
+			argv[nr_args++] = tokens[i];
+			continue;
+		}
+
+		target = tokens[i] + strlen(op->str);
+		size = __size_hint(&target);
+		if (size < 0) {
+			fprintf(stderr, "Bad size hint %s\n", tokens[i]);
+			goto out_err;
+		}
+		if (!*target) {
+			if (i + 1 == nr_tokens) {
+				fprintf(stderr, "Syntax error near unexpected newline\n");
+				goto out_err;
+			}
+			target = tokens[++i];
+		}
+
+		fd = op->here ? __here_string(target) : __open(op, target, size);
+		if (fd < 0) {
+			fprintf(stderr, "%s: %s\n", target, strerror(-fd));
+			redirect_close(fds);
+			return fd;
+		}
+
+		/* The last one wins as in other shells */
+		if (fds[op->fd] >= 0) close(fds[op->fd]);
+		fds[op->fd] = fd;
+	}
+	argv[nr_args] = NULL;
+	return nr_args;
+
+out_err:
+	redirect_close(fds);
+	return -EINVAL;
+}
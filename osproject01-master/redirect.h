@@ -0,0 +1,59 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __REDIRECT_H__
+#define __REDIRECT_H__
+
+#include "types.h"
+
+/**
+ * Redirections of external commands and the stages of pipelines;
+ *   < file       stdin from file
+ *   > file       stdout to file
+ *   >> file      stdout appended to file
+ *   2> file      stderr to file, and 2>> file to append
+ *   <<< word     stdin from word followed by a newline, through a pipe
+ *
+ * The file may be in the same token, e.g., >out.txt. Output files are
+ * preallocated with a size hint in brackets, e.g., >[64M] out.bin, so that
+ * a large output is laid out at once rather than block by block.
+ *
+ * The files are opened by the shell with O_CLOEXEC, and become the fds of
+ * the child with dup2() as &struct launch_attr says. So they are set up the
+ * same way for every launcher, and never leak into the other children.
+ * A file that cannot be opened fails the command before it is started.
+ */
+#define REDIRECT_INIT	{ -1, -1, -1 }
+
+/***********************************************************************
+ * redirect()
+ *
+ * DESCRIPTION
+ *  Open the redirections in @tokens into @fds for stdin, stdout, and
+ *  stderr, which should be REDIRECT_INIT, and copy the rest of @tokens to
+ *  @argv, which is terminated with NULL. @tokens is not changed.
+ *
+ * RETURN VALUE
+ *  Return the number of tokens in @argv, or -errno after reporting the
+ *  error. @fds are closed on error.
+ */
+int redirect(int nr_tokens, char * const tokens[], char *argv[], int fds[3]);
+
+/**
+ * Close the fds opened by redirect() once the child has its copies
+ */
+void redirect_close(int fds[3]);
+
+#endif
@@ -0,0 +1,202 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "parser.h"
+#include "script.h"
+
+static int __grow(void **array, int *max, int nr, size_t size)
+{
+	void *p;
+
+	if (nr < *max) return 0;
+
+	p = realloc(*array, size * (*max ? *max * 2 : 1024));
+	if (!p) return -ENOMEM;
+	*array = p;
+	*max = *max ? *max * 2 : 1024;
+	return 0;
+}
+
+/* Read this much at a time, and tokenize it while it is still in cache */
+#define SCRIPT_CHUNK	(64 << 10)
+
+struct loader {
+	const struct script_ops *ops;
+	struct script *script;
+	char *line;					/* Next line to tokenize */
+	int nr_tokens;
+	int max_tokens;
+	int max_lines;
+	int max_bodies;
+};
+
+/**
+ * Compile @tokens at @offset in script->tokens. The arrays keep moving while
+ * loading, so @tokens and @body hold the indices until __link() fixes them.
+ */
+static int __compile(struct loader *l, struct command *c,
+		int nr_tokens, char * const tokens[], long offset)
+{
+	struct script *script = l->script;
+	int body = 0, count = 0;
+	int ret;
+
+	*c = (struct command) {
+		.builtin = l->ops->resolve(nr_tokens, tokens, &body, &count),
+		.nr_tokens = nr_tokens,
+		.tokens = (char **)offset,
+		.count = count,
+	};
+	if (body <= 0 || body >= nr_tokens) return 0;
+
+	/* @c may be in the bodies, so it goes stale once they grow */
+	c->body = (struct command *)(long)(script->nr_bodies + 1);
+
+	ret = __grow((void **)&script->bodies, &l->max_bodies,
+			script->nr_bodies, sizeof(struct command));
+	if (ret) return ret;
+
+	return __compile(l, script->bodies + script->nr_bodies++,
+			nr_tokens - body, tokens + body, offset + body);
+}
+
+static void __link(struct script *script, struct command *commands, int nr)
+{
+	for (int i = 0; i < nr; i++) {
+		struct command *c = commands + i;
+
+		c->tokens = script->tokens + (long)c->tokens;
+		if (c->body) c->body = script->bodies + ((long)c->body - 1);
+	}
+}
+
+/* Tokenize and compile the lines in place up to @end, which must be '\n' */
+static int __tokenize(struct loader *l, char *end)
+{
+	struct script *script = l->script;
+	int ret;
+
+	while (l->line <= end) {
+		char *eol = memchr(l->line, '\n', end - l->line + 1);
+		char *tokens[MAX_NR_TOKENS] = { NULL };
+		int nr_tokens;
+
+		*eol = '\0';
+		if (parse_command(l->line, &nr_tokens, tokens)) {
+			if ((ret = __grow((void **)&script->tokens, &l->max_tokens,
+						l->nr_tokens + nr_tokens + 1, sizeof(char *))) ||
+					(ret = __grow((void **)&script->lines, &l->max_lines,
+						script->nr_lines, sizeof(struct command)))) {
+				return ret;
+			}
+			memcpy(script->tokens + l->nr_tokens, tokens,
+					sizeof(char *) * (nr_tokens + 1));
+
+			ret = __compile(l, script->lines + script->nr_lines++,
+					nr_tokens, tokens, l->nr_tokens);
+			if (ret) return ret;
+			l->nr_tokens += nr_tokens + 1;
+		}
+		l->line = eol + 1;
+	}
+	return 0;
+}
+
+static int __load(const char *filename, struct loader *l)
+{
+	struct script *script = l->script;
+	struct stat st;
+	size_t len = 0;
+	char *last;
+	int fd, ret = 0;
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return -errno;
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		goto out_close;
+	}
+
+	/* Room for '\n' and '\0' at the end */
+	script->buf = malloc(st.st_size + 2);
+	if (!script->buf) {
+		ret = -ENOMEM;
+		goto out_close;
+	}
+	l->line = script->buf;
+
+	while (len < st.st_size) {
+		size_t size = st.st_size - len;
+		ssize_t nr = read(fd, script->buf + len,
+				size < SCRIPT_CHUNK ? size : SCRIPT_CHUNK);
+
+		if (nr < 0 && errno == EINTR) continue;
+		if (nr < 0) {
+			ret = -errno;
+			goto out_close;
+		}
+		if (nr == 0) break;
+
+		/* Leave the partial line at the end for the next chunk */
+		last = memrchr(script->buf + len, '\n', nr);
+		len += nr;
+		if (last && (ret = __tokenize(l, last))) goto out_close;
+	}
+
+	if (len && script->buf[len - 1] != '\n') script->buf[len++] = '\n';
+	script->buf[len] = '\0';
+	if (len) ret = __tokenize(l, script->buf + len - 1);
+
+out_close:
+	close(fd);
+	return ret;
+}
+
+int load_script(const char *filename, const struct script_ops *ops,
+		struct script *script)
+{
+	struct loader l = { .ops = ops, .script = script };
+	int ret;
+
+	*script = (struct script) { 0 };
+
+	ret = __load(filename, &l);
+	if (ret) {
+		unload_script(script);
+		return ret;
+	}
+
+	__link(script, script->lines, script->nr_lines);
+	__link(script, script->bodies, script->nr_bodies);
+	return 0;
+}
+
+void unload_script(struct script *script)
+{
+	free(script->lines);
+	free(script->bodies);
+	free(script->tokens);
+	free(script->buf);
+	*script = (struct script) { 0 };
+}
@@ -0,0 +1,73 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include "types.h"
+
+/**
+ * Precompiled scripts for mysh -f.
+ *
+ * The whole script is read and tokenized once, and each line is compiled
+ * into &struct command with its builtin resolved by @resolve() of &struct
+ * script_ops. A command that runs the rest of its tokens, e.g., for N ... or
+ * time ..., gets the rest compiled into @body as well. So running a line
+ * again, or the body of a loop, neither tokenizes nor looks up the builtin
+ * again.
+ *
+ * Tokens point into the script buffer, which lives as long as the script.
+ */
+struct command {
+	int builtin;			/* What @resolve() of script_ops says */
+	int nr_tokens;
+	char **tokens;			/* Terminated with NULL */
+	int count;				/* Number of times to run @body */
+	struct command *body;
+};
+
+struct script_ops {
+	/**
+	 * Return the builtin to run @tokens. If the command runs @tokens + @body
+	 * in turn, set @body and the number of times to run it in @count.
+	 */
+	int (*resolve)(int nr_tokens, char * const tokens[], int *body, int *count);
+};
+
+struct script {
+	char *buf;
+	struct command *lines;		/* Empty lines are dropped */
+	int nr_lines;
+	struct command *bodies;		/* What the lines run in turn */
+	int nr_bodies;
+	char **tokens;
+};
+
+/***********************************************************************
+ * load_script()
+ *
+ * DESCRIPTION
+ *  Read the script in @filename and compile it into @script with @ops.
+ *  Empty lines are dropped.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -errno otherwise.
+ */
+int load_script(const char *filename, const struct script_ops *ops,
+		struct script *script);
+
+void unload_script(struct script *script);
+
+#endif
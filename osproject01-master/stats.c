@@ -0,0 +1,196 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "types.h"
+#include "tokenizer.h"
+#include "stats.h"
+
+struct usage usage_total;
+
+/**
+ * Commands are interned by the name, and the ID of each name indexes
+ * @entries. The wall times are kept for the percentiles.
+ */
+struct entry {
+	const char *name;
+	unsigned long count;
+	double *walls;
+	unsigned long max_walls;
+	double wall;
+	double cpu;
+};
+
+static struct {
+	bool enabled;
+	struct tok_intern names;
+	struct entry *entries;
+	unsigned int nr_entries;
+} __stats;
+
+static inline double __seconds(struct timeval tv)
+{
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double __now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void usage_add(struct usage *usage, const struct rusage *ru)
+{
+	usage->user += __seconds(ru->ru_utime);
+	usage->sys += __seconds(ru->ru_stime);
+	if (ru->ru_maxrss > usage->maxrss) usage->maxrss = ru->ru_maxrss;
+	usage->minflt += ru->ru_minflt;
+	usage->majflt += ru->ru_majflt;
+	usage->nvcsw += ru->ru_nvcsw;
+	usage->nivcsw += ru->ru_nivcsw;
+}
+
+void usage_mark(struct usage *mark)
+{
+	*mark = usage_total;
+	mark->wall = __now();
+
+	/* Start over the peak, and put it back in usage_report() */
+	usage_total.maxrss = 0;
+}
+
+void usage_report(const char *name, struct usage *mark)
+{
+	struct usage *t = &usage_total;
+
+	fprintf(stderr, "%s: real %.3fs user %.3fs sys %.3fs, "
+			"maxrss %ld KiB, faults %ld minor %ld major, "
+			"switches %ld voluntary %ld involuntary\n",
+			name, __now() - mark->wall, t->user - mark->user,
+			t->sys - mark->sys, t->maxrss, t->minflt - mark->minflt,
+			t->majflt - mark->majflt, t->nvcsw - mark->nvcsw,
+			t->nivcsw - mark->nivcsw);
+
+	if (mark->maxrss > t->maxrss) t->maxrss = mark->maxrss;
+}
+
+int stats_init(void)
+{
+	int ret = tok_intern_init(&__stats.names);
+
+	if (ret) return ret;
+	__stats.enabled = true;
+	return 0;
+}
+
+void stats_add(const char *name, const struct usage *usage)
+{
+	const struct tok_atom *atom;
+	struct entry *entry;
+
+	if (!__stats.enabled) return;
+
+	atom = tok_intern(&__stats.names, name, strlen(name));
+	if (!atom) return;
+
+	if (atom->id >= __stats.nr_entries) {
+		unsigned int nr = __stats.names.max_atoms;
+		struct entry *entries = realloc(__stats.entries, sizeof(*entries) * nr);
+
+		if (!entries) return;
+		memset(entries + __stats.nr_entries, 0,
+				sizeof(*entries) * (nr - __stats.nr_entries));
+		__stats.entries = entries;
+		__stats.nr_entries = nr;
+	}
+	entry = __stats.entries + atom->id;
+	entry->name = atom->str;
+
+	if (entry->count == entry->max_walls) {
+		unsigned long max = entry->max_walls ? entry->max_walls * 2 : 16;
+		double *walls = realloc(entry->walls, sizeof(*walls) * max);
+
+		if (!walls) return;
+		entry->walls = walls;
+		entry->max_walls = max;
+	}
+	entry->walls[entry->count++] = usage->wall;
+	entry->wall += usage->wall;
+	entry->cpu += usage->user + usage->sys;
+}
+
+static int __compare_walls(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int __compare_entries(const void *a, const void *b)
+{
+	const struct entry *x = a, *y = b;
+
+	/* The most time-consuming first */
+	return (x->wall < y->wall) - (x->wall > y->wall);
+}
+
+/* Nearest rank of the sorted @walls */
+static double __percentile(const struct entry *entry, int percent)
+{
+	unsigned long rank = (entry->count * percent + 99) / 100;
+
+	return entry->walls[rank ? rank - 1 : 0];
+}
+
+void stats_fini(void)
+{
+	unsigned int nr = 0;
+
+	if (!__stats.enabled) return;
+
+	/* Pack the entries used so far */
+	for (unsigned int i = 0; i < __stats.nr_entries; i++) {
+		if (__stats.entries[i].count) __stats.entries[nr++] = __stats.entries[i];
+	}
+	qsort(__stats.entries, nr, sizeof(struct entry), __compare_entries);
+
+	if (nr) {
+		fprintf(stderr, "%-20s %8s %10s %10s %10s\n",
+				"command", "count", "p50 ms", "p99 ms", "cpu s");
+	}
+	for (unsigned int i = 0; i < nr; i++) {
+		struct entry *entry = __stats.entries + i;
+
+		qsort(entry->walls, entry->count, sizeof(double), __compare_walls);
+		fprintf(stderr, "%-20s %8lu %10.1f %10.1f %10.3f\n",
+				entry->name, entry->count,
+				__percentile(entry, 50) * 1000,
+				__percentile(entry, 99) * 1000, entry->cpu);
+		free(entry->walls);
+	}
+
+	free(__stats.entries);
+	tok_intern_fini(&__stats.names);
+	__stats.entries = NULL;
+	__stats.nr_entries = 0;
+	__stats.enabled = false;
+}
@@ -0,0 +1,75 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <sys/resource.h>
+
+#include "types.h"
+
+/**
+ * Resource usage of external commands, as wait4() reports it for each child
+ * process. Times are in seconds, and @maxrss is the peak of the processes
+ * in KiB.
+ */
+struct usage {
+	double wall;
+	double user;
+	double sys;
+	long maxrss;
+	long minflt;
+	long majflt;
+	long nvcsw;
+	long nivcsw;
+};
+
+/**
+ * Usage of all the children reaped so far, whether they are supervised or not
+ */
+extern struct usage usage_total;
+
+/**
+ * Add @ru of a reaped child to @usage. The wall time is up to the caller
+ */
+void usage_add(struct usage *usage, const struct rusage *ru);
+
+/***********************************************************************
+ * usage_mark() / usage_report()
+ *
+ * DESCRIPTION
+ *  Mark the start of the command to time in @mark, and print what it has
+ *  used since then with usage_report(). The peak RSS counts the children
+ *  reaped in between only. Marks can nest.
+ */
+void usage_mark(struct usage *mark);
+void usage_report(const char *name, struct usage *mark);
+
+/***********************************************************************
+ * stats_add()
+ *
+ * DESCRIPTION
+ *  Account @usage of a finished command to @name, the first token of the
+ *  command. Nothing is recorded unless stats_init() is called.
+ */
+int stats_init(void);
+void stats_add(const char *name, const struct usage *usage);
+
+/**
+ * Print the table of the commands accounted so far, and free it
+ */
+void stats_fini(void);
+
+#endif
@@ -0,0 +1,507 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "types.h"
+#include "supervisor.h"
+#include "trace.h"
+
+#define MAX_EVENTS		64
+#define NR_PID_BUCKETS	4096	/* Should be a power of 2 */
+
+/**
+ * Supervised children hashed by the pid, so reaping a child does not have
+ * to search the tasks.
+ */
+struct child {
+	pid_t pid;
+	struct task *task;
+	int index;				/* In @task->pids[] */
+	struct child *next;
+};
+
+static struct {
+	int epfd;
+	int sfd;				/* signalfd for SIGCHLD */
+	int tfd;				/* timerfd for the earliest deadline */
+	bool interactive;		/* Hand the terminal to foreground tasks */
+
+	/* Min-heap of the timed tasks by the deadline */
+	struct task **timed;
+	int nr_timed;
+	int max_timed;
+
+	struct child *children[NR_PID_BUCKETS];
+} __sv = {
+	.epfd = -1,
+	.sfd = -1,
+	.tfd = -1,
+};
+
+/* Tell the fds in the epoll set apart */
+static int __sfd_tag;
+static int __tfd_tag;
+static int __input_tag;
+
+int supervisor_init(void)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = &__sfd_tag,
+	};
+	sigset_t mask;
+	int ret;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL)) return -errno;
+
+	__sv.sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (__sv.sfd < 0) goto out_fini;
+
+	__sv.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (__sv.epfd < 0) goto out_fini;
+
+	if (epoll_ctl(__sv.epfd, EPOLL_CTL_ADD, __sv.sfd, &ev)) goto out_fini;
+
+	__sv.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (__sv.tfd < 0) goto out_fini;
+
+	ev.data.ptr = &__tfd_tag;
+	if (epoll_ctl(__sv.epfd, EPOLL_CTL_ADD, __sv.tfd, &ev)) goto out_fini;
+
+	if (isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp()) {
+		/* Take the terminal back from the children without being stopped */
+		signal(SIGTTOU, SIG_IGN);
+		__sv.interactive = true;
+	}
+	return 0;
+
+out_fini:
+	ret = -errno;
+	supervisor_fini();
+	return ret;
+}
+
+void supervisor_fini(void)
+{
+	if (__sv.epfd >= 0) close(__sv.epfd);
+	if (__sv.sfd >= 0) close(__sv.sfd);
+	if (__sv.tfd >= 0) close(__sv.tfd);
+	__sv.epfd = __sv.sfd = __sv.tfd = -1;
+
+	free(__sv.timed);
+	__sv.timed = NULL;
+	__sv.nr_timed = __sv.max_timed = 0;
+}
+
+static double __now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline struct child **__bucket(pid_t pid)
+{
+	return __sv.children + (pid & (NR_PID_BUCKETS - 1));
+}
+
+/**
+ * Put @task at @i in the deadline heap, and keep its index in the task
+ */
+static inline void __place(struct task *task, int i)
+{
+	__sv.timed[i] = task;
+	task->timed = i;
+}
+
+static void __sift_up(int i)
+{
+	struct task *task = __sv.timed[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (__sv.timed[parent]->deadline <= task->deadline) break;
+		__place(__sv.timed[parent], i);
+		i = parent;
+	}
+	__place(task, i);
+}
+
+static void __sift_down(int i)
+{
+	struct task *task = __sv.timed[i];
+
+	while (2 * i + 1 < __sv.nr_timed) {
+		int child = 2 * i + 1;
+
+		if (child + 1 < __sv.nr_timed &&
+				__sv.timed[child + 1]->deadline < __sv.timed[child]->deadline) {
+			child++;
+		}
+		if (task->deadline <= __sv.timed[child]->deadline) break;
+		__place(__sv.timed[child], i);
+		i = child;
+	}
+	__place(task, i);
+}
+
+/**
+ * Arm the timerfd for the earliest deadline, or disarm it if nothing is timed
+ */
+static void __set_timer(void)
+{
+	struct itimerspec its = { 0 };
+
+	if (__sv.nr_timed) {
+		double deadline = __sv.timed[0]->deadline;
+
+		its.it_value.tv_sec = (time_t)deadline;
+		its.it_value.tv_nsec = (deadline - its.it_value.tv_sec) * 1e9;
+		/* Zero would disarm the timer rather than firing at once */
+		if (!its.it_value.tv_sec && !its.it_value.tv_nsec) its.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(__sv.tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * Reserve room in the deadline heap so that __arm() never fails
+ */
+static int __reserve_timed(void)
+{
+	struct task **timed;
+	int max = __sv.max_timed ? __sv.max_timed * 2 : 64;
+
+	if (__sv.nr_timed < __sv.max_timed) return 0;
+
+	timed = realloc(__sv.timed, sizeof(*timed) * max);
+	if (!timed) return -ENOMEM;
+
+	__sv.timed = timed;
+	__sv.max_timed = max;
+	return 0;
+}
+
+/**
+ * Time @task out @ms milliseconds from now. Room should have been reserved
+ * with __reserve_timed() if @task is not timed yet.
+ */
+static void __arm(struct task *task, unsigned int ms)
+{
+	bool earliest = task->timed == 0;
+
+	task->deadline = __now() + ms / 1000.0;
+
+	if (task->timed < 0) {
+		__place(task, __sv.nr_timed++);
+		__sift_up(task->timed);
+	} else {
+		/* Deadlines are only pushed back */
+		__sift_down(task->timed);
+	}
+	if (earliest || task->timed == 0) __set_timer();
+}
+
+static void __disarm(struct task *task)
+{
+	int i = task->timed;
+	struct task *last;
+
+	if (i < 0) return;
+
+	task->timed = -1;
+	last = __sv.timed[--__sv.nr_timed];
+	if (last != task) {
+		__place(last, i);
+		__sift_up(i);
+		__sift_down(last->timed);
+	}
+	if (i == 0) __set_timer();
+}
+
+struct task *supervise(pid_t pids[], int nr_pids, const char *name,
+		unsigned int timeout_ms)
+{
+	struct task *task = malloc(sizeof(*task));
+
+	if (!task) return NULL;
+
+	*task = (struct task) {
+		.pgid = pids[0],
+		.pids = malloc(sizeof(*pids) * nr_pids),
+		.nr_pids = nr_pids,
+		.nr_running = nr_pids,
+		.name = strdup(name),
+		.timed = -1,
+		.start = __now(),
+	};
+	if (!task->pids || !task->name) goto out_free;
+	if (timeout_ms && __reserve_timed()) goto out_free;
+	memcpy(task->pids, pids, sizeof(*pids) * nr_pids);
+
+	for (int i = 0; i < nr_pids; i++) {
+		struct child *child = malloc(sizeof(*child));
+		struct child **bucket = __bucket(pids[i]);
+
+		if (!child) goto out_free;
+
+		*child = (struct child) {
+			.pid = pids[i],
+			.task = task,
+			.index = i,
+			.next = *bucket,
+		};
+		*bucket = child;
+	}
+
+	if (timeout_ms) __arm(task, timeout_ms);
+	return task;
+
+out_free:
+	/* Children hashed already are dropped when they are reaped */
+	for (int i = 0; i < nr_pids && task->pids; i++) task->pids[i] = 0;
+	task->nr_running = 0;
+	free_task(task);
+	return NULL;
+}
+
+void free_task(struct task *task)
+{
+	/* Forget the children still running, e.g., when the shell exits */
+	for (int i = 0; i < task->nr_pids; i++) {
+		struct child **p = __bucket(task->pids[i]);
+
+		if (!task->pids[i]) continue;
+		while (*p) {
+			if ((*p)->task == task) {
+				struct child *child = *p;
+				*p = child->next;
+				free(child);
+				break;
+			}
+			p = &(*p)->next;
+		}
+	}
+	__disarm(task);
+	free(task->pids);
+	free(task->name);
+	free(task);
+}
+
+/**
+ * Tell if the child has been killed for the CPU time limit of the task rather
+ * than the timeout. Only CPU time is for sure, with SIGXCPU or SIGKILL past
+ * the hard limit.
+ */
+static void __check_limits(struct task *task, int status)
+{
+	const struct launch_limits *limits = &task->limits;
+	int sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+
+	if (!(limits->set & LIMIT_CPU) || task->timed_out || task->over_limit) return;
+
+	if (sig == SIGXCPU ||
+			(sig == SIGKILL && task->usage.user + task->usage.sys >= limits->cpu)) {
+		fprintf(stderr, "%s is over the CPU time limit of %lu seconds\n",
+				task->name, (unsigned long)limits->cpu);
+		task->over_limit = true;
+	}
+}
+
+/**
+ * Hint at the limits that the finished task may have failed for. A failure
+ * under them may be for anything else, so the task keeps its own status.
+ */
+static void __hint_limits(struct task *task)
+{
+	const struct launch_limits *limits = &task->limits;
+	int status = task->status;
+	int sig = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+
+	if (task->timed_out || task->over_limit) return;
+	if (!sig && !WEXITSTATUS(status)) return;
+
+	if ((limits->set & LIMIT_AS) &&
+			(sig == SIGSEGV || sig == SIGBUS || sig == SIGABRT || !sig)) {
+		fprintf(stderr, "%s may be over the address space limit of %lu MiB\n",
+				task->name, (unsigned long)(limits->as >> 20));
+	} else if ((limits->set & LIMIT_NOFILE) && !sig) {
+		fprintf(stderr, "%s may be over the open files limit of %lu\n",
+				task->name, (unsigned long)limits->nofile);
+	}
+}
+
+static void __reap(void)
+{
+	struct signalfd_siginfo info;
+	struct rusage ru;
+	pid_t pid;
+	int status;
+
+	/* SIGCHLDs are coalesced. Drain them and reap all exited children */
+	while (read(__sv.sfd, &info, sizeof(info)) == sizeof(info));
+
+	while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+		struct child **p = __bucket(pid);
+		struct child *child;
+		struct task *task;
+
+		usage_add(&usage_total, &ru);
+
+		while (*p && (*p)->pid != pid) p = &(*p)->next;
+		if (!*p) continue;		/* Not supervised */
+
+		child = *p;
+		*p = child->next;
+
+		task = child->task;
+		task->pids[child->index] = 0;
+		task->nr_running--;
+		if (child->index == task->nr_pids - 1) task->status = status;
+		usage_add(&task->usage, &ru);
+		__check_limits(task, status);
+		trace_span("exec", task->name, task->start, pid, "status", status);
+		free(child);
+
+		if (!task->nr_running) {
+			__disarm(task);
+			__hint_limits(task);
+			task->usage.wall = __now() - task->start;
+			stats_add(task->name, &task->usage);
+		}
+	}
+}
+
+static void __expire(struct task *task)
+{
+	if (!task->timed_out) {
+		task->timed_out = true;
+		fprintf(stderr, "%s is timed out\n", task->name);
+		kill(-task->pgid, SIGTERM);
+		trace_instant("timeout", "SIGTERM", task->pgid);
+		__arm(task, KILL_GRACE_MS);
+	} else {
+		task->killed = true;
+		kill(-task->pgid, SIGKILL);
+		trace_instant("timeout", "SIGKILL", task->pgid);
+		__disarm(task);
+	}
+}
+
+/**
+ * Expire all the tasks past their deadlines, and arm the timer for the rest
+ */
+static void __expire_timed(void)
+{
+	unsigned long long expirations;
+	double now = __now();
+
+	if (read(__sv.tfd, &expirations, sizeof(expirations)) < 0) return;
+
+	/* __expire() pushes the deadline back or disarms, so this ends */
+	while (__sv.nr_timed && __sv.timed[0]->deadline <= now) {
+		__expire(__sv.timed[0]);
+	}
+	__set_timer();
+}
+
+/**
+ * Handle the events for @timeout_ms (-1 to block). @input is set if the input
+ * registered by wait_readable() is ready. Return the number of events.
+ */
+static int __run_events(int timeout_ms, bool *input)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int nr;
+
+	nr = epoll_wait(__sv.epfd, events, MAX_EVENTS, timeout_ms);
+	for (int i = 0; i < nr; i++) {
+		void *ptr = events[i].data.ptr;
+
+		if (ptr == &__sfd_tag) {
+			__reap();
+		} else if (ptr == &__tfd_tag) {
+			__expire_timed();
+		} else if (ptr == &__input_tag) {
+			*input = true;
+		}
+	}
+	return nr;
+}
+
+void poll_tasks(void)
+{
+	bool input = false;
+
+	while (__run_events(0, &input) == MAX_EVENTS);
+}
+
+void wait_events(void)
+{
+	bool input = false;
+
+	__run_events(-1, &input);
+}
+
+void wait_task(struct task *task, bool foreground)
+{
+	bool terminal = foreground && __sv.interactive;
+	double start = trace_now();
+
+	if (terminal) tcsetpgrp(STDIN_FILENO, task->pgid);
+
+	while (task->nr_running) {
+		bool input = false;
+
+		__run_events(-1, &input);
+	}
+
+	if (terminal) tcsetpgrp(STDIN_FILENO, getpgrp());
+	trace_span("wait", task->name, start, 0, NULL, 0);
+}
+
+void wait_readable(int fd)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = &__input_tag,
+	};
+
+	bool input = false;
+
+	if (!__sv.nr_timed) return;
+	if (epoll_ctl(__sv.epfd, EPOLL_CTL_ADD, fd, &ev)) return;
+
+	while (__sv.nr_timed && !input) {
+		__run_events(-1, &input);
+	}
+
+	epoll_ctl(__sv.epfd, EPOLL_CTL_DEL, fd, NULL);
+}
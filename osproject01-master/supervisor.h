@@ -0,0 +1,108 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __SUPERVISOR_H__
+#define __SUPERVISOR_H__
+
+#include <sys/types.h>
+
+#include "types.h"
+#include "stats.h"
+#include "launch.h"
+
+/**
+ * Supervisor of the children in an epoll event loop.
+ *
+ * A command or a pipeline runs in a process group of its own, and is
+ * supervised as a &struct task. The deadlines of the tasks are kept in a
+ * min-heap, and one timerfd in the epoll set is armed for the earliest of
+ * them. SIGCHLD comes in through a signalfd in the same set, so any number of
+ * tasks are timed at once with millisecond resolution, without a descriptor
+ * for each.
+ *
+ * When a task times out, its process group gets SIGTERM, and then SIGKILL if
+ * it is still around after KILL_GRACE_MS.
+ *
+ * The event loop runs while the shell waits for a task, or for the input with
+ * wait_readable(). SIGCHLD is blocked in the shell, and the children get the
+ * signal mask cleared when they are launched.
+ */
+#define KILL_GRACE_MS	500
+
+struct task {
+	pid_t pgid;
+	pid_t *pids;		/* 0 once reaped */
+	int nr_pids;
+	int nr_running;
+	int status;			/* Wait status of the last process */
+	char *name;
+
+	double deadline;	/* In seconds, while timed */
+	int timed;			/* Index in the deadline heap, -1 if not timed */
+	bool timed_out;
+	bool killed;		/* SIGKILL is sent after SIGTERM */
+
+	struct launch_limits limits;	/* Set by the caller to tell a limit hit */
+	bool over_limit;
+
+	struct usage usage;	/* Of the processes reaped so far */
+	double start;		/* When supervised, in seconds */
+};
+
+int supervisor_init(void);
+void supervisor_fini(void);
+
+/***********************************************************************
+ * supervise()
+ *
+ * DESCRIPTION
+ *  Supervise the children in @pids[] as a task named @name, and kill them
+ *  after @timeout_ms milliseconds unless @timeout_ms is 0. The children
+ *  should be in the process group of @pids[0].
+ *
+ * RETURN VALUE
+ *  Return the task, or NULL if out of memory.
+ */
+struct task *supervise(pid_t pids[], int nr_pids, const char *name,
+		unsigned int timeout_ms);
+
+/**
+ * Run the event loop until @task finishes. A task waited in the foreground
+ * gets the terminal while the shell is interactive.
+ */
+void wait_task(struct task *task, bool foreground);
+
+/**
+ * Free the finished @task
+ */
+void free_task(struct task *task);
+
+/**
+ * Handle the events arrived so far without blocking
+ */
+void poll_tasks(void);
+
+/**
+ * Block until some events arrive, and handle them
+ */
+void wait_events(void);
+
+/**
+ * Run the event loop until @fd gets readable. Return at once when nothing is
+ * timed, or when @fd cannot be polled such as a regular file.
+ */
+void wait_readable(int fd);
+
+#endif
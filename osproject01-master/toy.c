@@ -13,6 +13,17 @@
  *
  **********************************************************************/
 
+/**
+ * Toy command to run from mysh; it prints its arguments, and then runs the
+ * modes in the arguments in order as a load for benchmarking the shell:
+ *   sleep N    sleep N seconds
+ *   burn N     spin until N milliseconds of CPU time are used
+ *   touch N    allocate N MiB, and write to every page of it
+ *   bs N       block size of write, like 4096, 64K, or 1M (64K by default)
+ *   write N    write N MiB of zeros to stdout in blocks of bs
+ *   exit N     exit with the status N after all
+ * The other arguments are only printed.
+ */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,9 +31,74 @@
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+
+#define DEFAULT_BLOCK_SIZE	(64 << 10)
+
+static size_t parse_size(const char *str)
+{
+	char *end;
+	size_t size = strtoul(str, &end, 10);
+
+	if (*end == 'k' || *end == 'K') size <<= 10;
+	else if (*end == 'm' || *end == 'M') size <<= 20;
+	return size;
+}
+
+static double cpu_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void burn(long ms)
+{
+	double until = cpu_ms() + ms;
+	volatile unsigned long spin = 0;
+
+	while (cpu_ms() < until) {
+		for (int i = 0; i < 10000; i++) spin++;
+	}
+}
+
+/* Stays allocated until exit, as a command growing up to the size */
+static int touch(size_t size)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	char *mem = malloc(size);
+
+	if (!mem) return -ENOMEM;
+	for (size_t i = 0; i < size; i += page) mem[i] = 1;
+	return 0;
+}
+
+static int write_out(size_t size, size_t block_size)
+{
+	char *block = calloc(1, block_size);
+
+	if (!block) return -ENOMEM;
+	while (size) {
+		size_t len = size < block_size ? size : block_size;
+		ssize_t ret = write(STDOUT_FILENO, block, len);
+
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			free(block);
+			return -errno;
+		}
+		size -= ret;
+	}
+	free(block);
+	return 0;
+}
 
 int main(int argc, const char *argv[])
 {
+	size_t block_size = DEFAULT_BLOCK_SIZE;
+	int status = 0;
+
 	fprintf(stderr, "pid  = %d\n", getpid());
 	fprintf(stderr, "argc = %d\n", argc);
 
@@ -30,12 +106,35 @@ int main(int argc, const char *argv[])
 		fprintf(stderr, "argv[%d] = %s\n", i, argv[i]);
 	}
 
-	if (argc >= 3 && strncmp(argv[1], "sleep", strlen("sleep")) == 0) {
-		int sleep_sec = sleep_sec = atoi(argv[2]);
-		sleep(sleep_sec);
+	for (int i = 1; i + 1 < argc; i++) {
+		const char *mode = argv[i], *value = argv[i + 1];
+		int ret = 0;
+
+		if (strncmp(mode, "sleep", strlen("sleep")) == 0) {
+			int sleep_sec = atoi(value);
+			sleep(sleep_sec);
+		} else if (strcmp(mode, "burn") == 0) {
+			burn(atol(value));
+		} else if (strcmp(mode, "touch") == 0) {
+			ret = touch((size_t)atol(value) << 20);
+		} else if (strcmp(mode, "bs") == 0) {
+			block_size = parse_size(value);
+			if (!block_size) block_size = DEFAULT_BLOCK_SIZE;
+		} else if (strcmp(mode, "write") == 0) {
+			ret = write_out((size_t)atol(value) << 20, block_size);
+		} else if (strcmp(mode, "exit") == 0) {
+			status = atoi(value);
+		} else {
+			continue;
+		}
+		if (ret) {
+			fprintf(stderr, "%s %s: %s\n", mode, value, strerror(-ret));
+			return EXIT_FAILURE;
+		}
+		i++;
 	}
 
 	fprintf(stderr, "done!\n");
 
-	return 0;
+	return status;
 }
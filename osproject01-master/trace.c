@@ -0,0 +1,192 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "trace.h"
+
+struct trace_event {
+	double ts;				/* In seconds */
+	double dur;
+	const char *cat;
+	const char *arg;		/* NULL without the argument */
+	long value;
+	pid_t tid;
+	char phase;
+	char name[TRACE_NAME_LEN];
+};
+
+static struct {
+	FILE *file;
+	struct trace_event *events;	/* NULL when not tracing */
+	unsigned long nr_events;	/* Recorded so far, including the ones overwritten */
+	double base;				/* Timestamps are from here */
+	pid_t pid;
+} __trace;
+
+static double __clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int trace_init(const char *filename)
+{
+	size_t size = sizeof(*__trace.events) * TRACE_NR_EVENTS;
+
+	__trace.file = fopen(filename, "w");
+	if (!__trace.file) {
+		perror(filename);
+		return -errno;
+	}
+
+	__trace.events = malloc(size);
+	if (!__trace.events) {
+		perror("trace");
+		fclose(__trace.file);
+		__trace.file = NULL;
+		return -ENOMEM;
+	}
+	/* Fault the ring in now, not while recording */
+	memset(__trace.events, 0, size);
+
+	__trace.nr_events = 0;
+	__trace.pid = getpid();
+	__trace.base = __clock();
+	return 0;
+}
+
+double trace_now(void)
+{
+	return __trace.events ? __clock() : 0;
+}
+
+static struct trace_event *__record(const char *cat, const char *name, pid_t tid)
+{
+	struct trace_event *e = __trace.events + (__trace.nr_events++ % TRACE_NR_EVENTS);
+
+	e->cat = cat;
+	e->tid = tid ? tid : __trace.pid;
+	strncpy(e->name, name, TRACE_NAME_LEN - 1);
+	e->name[TRACE_NAME_LEN - 1] = '\0';
+	return e;
+}
+
+void trace_span(const char *cat, const char *name, double start, pid_t tid,
+		const char *arg, long value)
+{
+	struct trace_event *e;
+	double now;
+
+	if (!__trace.events) return;
+
+	now = __clock();
+	e = __record(cat, name, tid);
+	e->phase = 'X';
+	e->ts = start;
+	e->dur = now - start;
+	e->arg = arg;
+	e->value = value;
+}
+
+void trace_instant(const char *cat, const char *name, pid_t tid)
+{
+	struct trace_event *e;
+
+	if (!__trace.events) return;
+
+	e = __record(cat, name, tid);
+	e->phase = 'i';
+	e->ts = __clock();
+	e->dur = 0;
+	e->arg = NULL;
+}
+
+/**
+ * Print @str as a JSON string
+ */
+static void __print_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+		else if (c < 0x20) fprintf(file, "\\u%04x", c);
+		else fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+static void __print_name(FILE *file, pid_t tid, const char *name)
+{
+	fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+			__trace.pid, tid);
+	__print_string(file, name);
+	fprintf(file, "}}");
+}
+
+static void __print_event(FILE *file, const struct trace_event *e)
+{
+	/* Name the track of the child after the command */
+	if (e->phase == 'X' && e->tid != __trace.pid && strcmp(e->cat, "exec") == 0) {
+		__print_name(file, e->tid, e->name);
+		fprintf(file, ",\n");
+	}
+
+	fprintf(file, "{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":", e->phase, e->cat);
+	__print_string(file, e->name);
+	fprintf(file, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+			__trace.pid, e->tid, (e->ts - __trace.base) * 1e6);
+	if (e->phase == 'X') fprintf(file, ",\"dur\":%.3f", e->dur * 1e6);
+	else fprintf(file, ",\"s\":\"t\"");
+	if (e->arg) fprintf(file, ",\"args\":{\"%s\":%ld}", e->arg, e->value);
+	fprintf(file, "}");
+}
+
+void trace_fini(void)
+{
+	FILE *file = __trace.file;
+	unsigned long first = 0;
+
+	if (!__trace.events) return;
+
+	if (__trace.nr_events > TRACE_NR_EVENTS)
+		first = __trace.nr_events - TRACE_NR_EVENTS;
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":\"mysh\"}},\n",
+			__trace.pid);
+	__print_name(file, __trace.pid, "shell");
+	for (unsigned long i = first; i < __trace.nr_events; i++) {
+		fprintf(file, ",\n");
+		__print_event(file, __trace.events + (i % TRACE_NR_EVENTS));
+	}
+	fprintf(file, "\n],\n\"displayTimeUnit\":\"ms\",\n");
+	fprintf(file, "\"otherData\":{\"dropped\":%lu}}\n", first);
+
+	if (fclose(file)) perror("trace");
+	free(__trace.events);
+	__trace.events = NULL;
+	__trace.file = NULL;
+}
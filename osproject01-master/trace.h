@@ -0,0 +1,80 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <sys/types.h>
+
+#include "types.h"
+
+/**
+ * Execution trace of the shell in the Chrome trace event format, to be
+ * viewed on a timeline with chrome://tracing or Perfetto.
+ *
+ * Events are complete ("X") events with the start and the duration, and
+ * instant ("i") events. The shell records them on its own track, and each
+ * child gets a track of its pid for the time from being supervised to being
+ * reaped:
+ *   builtin   every builtin dispatched, named after its first token
+ *   external  every external command or pipeline dispatched
+ *   for       each iteration of for
+ *   launch    starting a child with the launcher, which includes the exec
+ *             for vfork and spawn
+ *   exec      a child from its launch to its exit
+ *   wait      the shell waiting for a foreground command
+ *   timeout   SIGTERM and SIGKILL sent to a command timed out
+ *
+ * Events go to a ring allocated and touched up front, so recording one is a
+ * clock read and a copy. The ring keeps the latest TRACE_NR_EVENTS events,
+ * and is written out by trace_fini() at exit.
+ */
+#define TRACE_NR_EVENTS	(1 << 16)
+#define TRACE_NAME_LEN	32
+
+/**
+ * Start tracing into @filename, which is created at once
+ */
+int trace_init(const char *filename);
+
+/**
+ * Write the events recorded to the file, and stop tracing
+ */
+void trace_fini(void);
+
+/**
+ * Current time in seconds for the start of an event, or 0 when not tracing.
+ * The clock is CLOCK_MONOTONIC, the same as &struct task->start.
+ */
+double trace_now(void);
+
+/***********************************************************************
+ * trace_span()
+ *
+ * DESCRIPTION
+ *  Record an event of @cat named @name from @start to now, on the track of
+ *  @tid or of the shell if @tid is 0. The event carries @value as @arg
+ *  unless @arg is NULL. @cat and @arg should be string literals, and @name
+ *  is copied.
+ */
+void trace_span(const char *cat, const char *name, double start, pid_t tid,
+		const char *arg, long value);
+
+/**
+ * Record an instant event of @cat named @name on the track of @tid
+ */
+void trace_instant(const char *cat, const char *name, pid_t tid);
+
+#endif
@@ -0,0 +1,389 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include "types.h"
+#include "launch.h"
+#include "zygote.h"
+
+#define ZYGOTE_ENV		"MYSH_ZYGOTE"
+#define ZYGOTE_NAME		"mysh-zygote"
+#define ZYGOTE_FD		3				/* The socket in the zygote */
+#define ZYGOTE_MAX_MSG	(128 << 10)		/* Fits the default socket buffer */
+
+extern char **environ;
+
+/**
+ * A request is the header followed by NUL-terminated strings; the path,
+ * @argc arguments, the cwd, and @envc environment variables. stdin, stdout,
+ * and stderr for the command are attached with SCM_RIGHTS.
+ */
+struct zygote_request {
+	int argc;
+	int envc;
+	pid_t pgid;				/* 0 for a new process group */
+	bool limited;			/* Set @limits in the child */
+	struct launch_limits limits;
+};
+
+struct zygote_reply {
+	pid_t pid;				/* Still to be reaped on error if > 0 */
+	int error;
+};
+
+static struct {
+	int fd;					/* Socket to the zygote */
+	pid_t pid;
+	char *buf;				/* Strings of the request being sent */
+} __zygote = {
+	.fd = -1,
+};
+
+
+/***********************************************************************
+ * The shell side
+ */
+static int __start(void)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t spawnattr;
+	char *argv[] = { ZYGOTE_NAME, NULL };
+	char **envp;
+	sigset_t none, defaults;
+	int nr_env = 0;
+	int sv[2];
+	int ret;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv)) return -errno;
+
+	while (environ[nr_env]) nr_env++;
+	envp = malloc(sizeof(*envp) * (nr_env + 2));
+	if (!envp) {
+		ret = ENOMEM;
+		goto out_close;
+	}
+	memcpy(envp, environ, sizeof(*envp) * nr_env);
+	envp[nr_env] = ZYGOTE_ENV "=1";
+	envp[nr_env + 1] = NULL;
+
+	/* In a group of its own not to get the signals from the terminal */
+	sigemptyset(&none);
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGTTOU);
+	posix_spawnattr_init(&spawnattr);
+	posix_spawnattr_setsigmask(&spawnattr, &none);
+	posix_spawnattr_setsigdefault(&spawnattr, &defaults);
+	posix_spawnattr_setpgroup(&spawnattr, 0);
+	posix_spawnattr_setflags(&spawnattr, POSIX_SPAWN_SETSIGMASK |
+			POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+	posix_spawn_file_actions_init(&actions);
+	ret = posix_spawn_file_actions_adddup2(&actions, sv[1], ZYGOTE_FD);
+
+	/* A fresh image of this program rather than a copy of the shell */
+	if (!ret) ret = posix_spawn(&__zygote.pid, "/proc/self/exe", &actions,
+			&spawnattr, argv, envp);
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&spawnattr);
+	free(envp);
+
+	if (!ret) {
+		close(sv[1]);
+		__zygote.fd = sv[0];
+		return 0;
+	}
+
+out_close:
+	close(sv[0]);
+	close(sv[1]);
+	return -ret;
+}
+
+void zygote_stop(void)
+{
+	if (__zygote.fd < 0) return;
+
+	close(__zygote.fd);
+	__zygote.fd = -1;
+
+	/* It may have been reaped already if it died */
+	waitpid(__zygote.pid, NULL, 0);
+	free(__zygote.buf);
+	__zygote.buf = NULL;
+}
+
+static char *__pack(char *p, const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	memcpy(p, str, len);
+	return p + len;
+}
+
+static int __send(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	struct zygote_request req = {
+		.pgid = attr && attr->pgid >= 0 ? attr->pgid : getpgrp(),
+		.limited = attr && attr->limits,
+	};
+	char cwd[PATH_MAX] = "";
+	size_t len;
+	char *p;
+	int fds[3];
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov[2];
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = 2,
+		.msg_control = control.buf,
+		.msg_controllen = sizeof(control.buf),
+	};
+	struct cmsghdr *cmsg;
+
+	if (req.limited) req.limits = *attr->limits;
+
+	/* The command starts where the zygote is if the cwd has gone */
+	if (!getcwd(cwd, sizeof(cwd))) cwd[0] = '\0';
+
+	len = strlen(path) + strlen(cwd) + 2;
+	for (; argv[req.argc]; req.argc++) len += strlen(argv[req.argc]) + 1;
+	for (; environ[req.envc]; req.envc++) len += strlen(environ[req.envc]) + 1;
+	if (len > ZYGOTE_MAX_MSG - sizeof(req)) return -EMSGSIZE;
+
+	if (!__zygote.buf) __zygote.buf = malloc(ZYGOTE_MAX_MSG);
+	if (!__zygote.buf) return -ENOMEM;
+
+	p = __pack(__zygote.buf, path);
+	for (int i = 0; i < req.argc; i++) p = __pack(p, argv[i]);
+	p = __pack(p, cwd);
+	for (int i = 0; i < req.envc; i++) p = __pack(p, environ[i]);
+
+	/* Send the fds of the shell for those to inherit */
+	for (int i = 0; i < 3; i++) {
+		fds[i] = attr && attr->fds[i] >= 0 ? attr->fds[i] : i;
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	iov[0] = (struct iovec) { .iov_base = &req, .iov_len = sizeof(req) };
+	iov[1] = (struct iovec) { .iov_base = __zygote.buf, .iov_len = len };
+
+	while (sendmsg(__zygote.fd, &msg, MSG_NOSIGNAL) < 0) {
+		if (errno != EINTR) return -errno;
+	}
+	return 0;
+}
+
+int zygote_start(void)
+{
+	if (__zygote.fd >= 0) return 0;
+	return __start();
+}
+
+pid_t zygote_launch(const char *path, char * const argv[],
+		const struct launch_attr *attr)
+{
+	struct zygote_reply reply;
+
+	/* Start another zygote once if it has gone */
+	for (int i = 0; i < 2; i++) {
+		ssize_t len;
+		int ret;
+
+		if (zygote_start()) return -ENOTCONN;
+
+		ret = __send(path, argv, attr);
+		if (ret == -EMSGSIZE || ret == -ENOMEM) return -ENOTCONN;
+
+		if (!ret) {
+			while ((len = recv(__zygote.fd, &reply, sizeof(reply), 0)) < 0 &&
+					errno == EINTR);
+			if (len == sizeof(reply)) goto out;
+		}
+		zygote_stop();
+	}
+	return -ENOTCONN;
+
+out:
+	if (reply.error) {
+		if (reply.pid > 0) waitpid(reply.pid, NULL, 0);
+		return -reply.error;
+	}
+	return reply.pid;
+}
+
+
+/***********************************************************************
+ * The zygote side
+ */
+static char *__unpack(char **p)
+{
+	char *str = *p;
+
+	*p += strlen(str) + 1;
+	return str;
+}
+
+static struct zygote_reply __fork_exec(const char *path, char * const argv[],
+		const char *cwd, char * const envp[], const struct launch_attr *attr)
+{
+	struct zygote_reply reply = { 0 };
+	int pipefd[2];
+
+	/* Hear the failure of exec from the child */
+	if (pipe2(pipefd, O_CLOEXEC)) {
+		reply.error = errno;
+		return reply;
+	}
+
+	/* fork() to the shell rather than to the zygote */
+	reply.pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, NULL, NULL, 0);
+	if (reply.pid == 0) {
+		int error = -setup_child(attr);
+
+		if (!error && cwd[0] && chdir(cwd)) error = errno;
+		if (!error) {
+			execve(path, argv, envp);
+			error = errno;
+		}
+		write(pipefd[1], &error, sizeof(error));
+		_exit(127);
+	}
+	close(pipefd[1]);
+
+	if (reply.pid < 0) {
+		reply.error = errno;
+	} else if (read(pipefd[0], &reply.error, sizeof(reply.error)) !=
+			sizeof(reply.error)) {
+		reply.error = 0;	/* Closed on exec */
+	}
+	close(pipefd[0]);
+	return reply;
+}
+
+static void __serve(int fd)
+{
+	char *buf = malloc(ZYGOTE_MAX_MSG);
+	char **argv = NULL, **envp = NULL;
+	int max_argv = 0, max_envp = 0;
+
+	if (!buf) return;
+
+	for (;;) {
+		struct zygote_request req;
+		struct zygote_reply reply;
+		struct launch_attr attr = LAUNCH_ATTR_INIT;
+		union {
+			char buf[CMSG_SPACE(sizeof(attr.fds))];
+			struct cmsghdr align;
+		} control;
+		struct iovec iov[2] = {
+			{ .iov_base = &req, .iov_len = sizeof(req) },
+			{ .iov_base = buf, .iov_len = ZYGOTE_MAX_MSG },
+		};
+		struct msghdr msg = {
+			.msg_iov = iov,
+			.msg_iovlen = 2,
+			.msg_control = control.buf,
+			.msg_controllen = sizeof(control.buf),
+		};
+		struct cmsghdr *cmsg;
+		ssize_t len;
+		char *p = buf;
+		char *path, *cwd;
+
+		len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+		if (len < 0 && errno == EINTR) continue;
+		if (len <= 0) break;	/* The shell has gone */
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+				memcpy(attr.fds, CMSG_DATA(cmsg), sizeof(attr.fds));
+			}
+		}
+		attr.pgid = req.pgid;
+		if (req.limited) attr.limits = &req.limits;
+
+		if (req.argc >= max_argv) {
+			max_argv = req.argc + 1;
+			argv = realloc(argv, sizeof(*argv) * max_argv);
+		}
+		if (req.envc >= max_envp) {
+			max_envp = req.envc + 1;
+			envp = realloc(envp, sizeof(*envp) * max_envp);
+		}
+		if (!argv || !envp) break;
+
+		path = __unpack(&p);
+		for (int i = 0; i < req.argc; i++) argv[i] = __unpack(&p);
+		argv[req.argc] = NULL;
+		cwd = __unpack(&p);
+		for (int i = 0; i < req.envc; i++) envp[i] = __unpack(&p);
+		envp[req.envc] = NULL;
+
+		reply = __fork_exec(path, argv, cwd, envp, &attr);
+
+		for (int i = 0; i < 3; i++) {
+			if (attr.fds[i] >= 0) close(attr.fds[i]);
+		}
+		if (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) < 0) break;
+	}
+
+	free(argv);
+	free(envp);
+	free(buf);
+}
+
+/**
+ * The zygote runs the server before main() of the program it is started
+ * from, and never returns to it.
+ */
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void __zygote_main(void)
+{
+	if (!getenv(ZYGOTE_ENV)) return;
+
+	/* Not to be shown as exe of /proc/self/exe */
+	prctl(PR_SET_NAME, ZYGOTE_NAME);
+	fcntl(ZYGOTE_FD, F_SETFD, FD_CLOEXEC);
+	close_range(ZYGOTE_FD + 1, ~0U, 0);
+
+	__serve(ZYGOTE_FD);
+	_exit(EXIT_SUCCESS);
+}
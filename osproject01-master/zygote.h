@@ -0,0 +1,69 @@
+/**********************************************************************
+ * Copyright (c) 2020
+ *  Sang-Hoon Kim <sanghoonkim@ajou.ac.kr>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTIABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ **********************************************************************/
+
+#ifndef __ZYGOTE_H__
+#define __ZYGOTE_H__
+
+#include <sys/types.h>
+
+#include "launch.h"
+
+/**
+ * Fork server for the zygote launcher.
+ *
+ * The zygote is a small helper process started from a fresh image of the
+ * program, so its address space does not grow with the shell. The shell
+ * sends it argv, the cwd, and the environment of each command with the fds
+ * to become stdin, stdout, and stderr over a Unix socket, and the zygote
+ * forks and execs the command.
+ *
+ * The commands are cloned with CLONE_PARENT to be the children of the shell
+ * rather than of the zygote. So the exit status and the resource usage come
+ * back to the shell asynchronously with SIGCHLD just like with the other
+ * launchers, and the shell can set their process groups and kill them.
+ */
+
+/***********************************************************************
+ * zygote_launch()
+ *
+ * DESCRIPTION
+ *  Start @path with @argv through the zygote, starting the zygote first if
+ *  it is not running.
+ *
+ * RETURN VALUE
+ *  Return the pid of the child, or -errno if the command cannot be started.
+ *  -ENOTCONN means the zygote cannot be used at all.
+ */
+pid_t zygote_launch(const char *path, char * const argv[],
+		const struct launch_attr *attr);
+
+/***********************************************************************
+ * zygote_start()
+ *
+ * DESCRIPTION
+ *  Start the zygote ahead of the first command unless it is running, so
+ *  that command does not wait for the program image to be loaded.
+ *
+ * RETURN VALUE
+ *  Return 0 on success, -errno otherwise.
+ */
+int zygote_start(void);
+
+/**
+ * Let the zygote go. It exits when the shell closes the socket
+ */
+void zygote_stop(void);
+
+#endif
@@ -27,6 +27,7 @@
 #include "list_head.h"
 
 #include "parser.h"
+#include "tokenizer.h"
 #include "process.h"
 #include "resource.h"
 
@@ -134,9 +135,37 @@ void dump_status(void)
 	fprintf(stderr, string "\n", ##args); \
 } while (0);
 
-static inline bool strmatch(char * const str, const char *expect)
+/**
+ * Properties in the process script. They are interned first in this order,
+ * so that the IDs of their atoms are the same as the enum values, and tokens
+ * are matched by the IDs instead of comparing the strings.
+ */
+enum property {
+	PROP_PROCESS,
+	PROP_END,
+	PROP_LIFESPAN,
+	PROP_PRIO,
+	PROP_START,
+	PROP_ACQUIRE,
+	NR_PROPERTIES,
+};
+
+static const char * const __properties[NR_PROPERTIES] = {
+	[PROP_PROCESS] = "process",
+	[PROP_END] = "end",
+	[PROP_LIFESPAN] = "lifespan",
+	[PROP_PRIO] = "prio",
+	[PROP_START] = "start",
+	[PROP_ACQUIRE] = "acquire",
+};
+
+static struct tok_intern __atoms;
+
+static int __lookup_property(char * const token)
 {
-	return (strlen(str) == strlen(expect)) && (strncmp(str, expect, strlen(expect)) == 0);
+	const struct tok_atom *atom = tok_intern_find(&__atoms, token, strlen(token));
+
+	return atom ? atom->id : NR_PROPERTIES;
 }
 
 static void __briefing_process(struct process *p)
@@ -160,15 +189,31 @@ static int __load_script(char * const filename)
 	struct process *p = NULL;
 
 	FILE *file = fopen(filename, "r");
+
+	if (!file) {
+		perror(filename);
+		return false;
+	}
+	if (tok_intern_init(&__atoms)) {
+		fclose(file);
+		return false;
+	}
+	for (int i = 0; i < NR_PROPERTIES; i++) {
+		tok_intern(&__atoms, __properties[i], strlen(__properties[i]));
+	}
+
 	while (fgets(line, sizeof(line), file)) {
 		char *tokens[32] = { NULL };
 		int nr_tokens;
+		int prop;
 
 		parse_command(line, &nr_tokens, tokens);
 
 		if (nr_tokens == 0) continue;
 
-		if (strmatch(tokens[0], "process")) {
+		prop = __lookup_property(tokens[0]);
+
+		if (prop == PROP_PROCESS) {
 			assert(nr_tokens == 2);
 			/* Start processor description */
 			p = malloc(sizeof(*p));
@@ -181,7 +226,7 @@ static int __load_script(char * const filename)
 			INIT_LIST_HEAD(&p->__resources_holding);
 
 			continue;
-		} else if (strmatch(tokens[0], "end")) {
+		} else if (prop == PROP_END) {
 			/* End of process description */
 			struct resource_schedule *rs;
 			assert(p);
@@ -194,16 +239,16 @@ static int __load_script(char * const filename)
 			continue;
 		}
 
-		if (strmatch(tokens[0], "lifespan")) {
+		if (prop == PROP_LIFESPAN) {
 			assert(nr_tokens == 2);
 			p->lifespan = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "prio")) {
+		} else if (prop == PROP_PRIO) {
 			assert(nr_tokens == 2);
 			p->prio = p->prio_orig = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "start")) {
+		} else if (prop == PROP_START) {
 			assert(nr_tokens == 2);
 			p->__starts_at = atoi(tokens[1]);
-		} else if (strmatch(tokens[0], "acquire")) {
+		} else if (prop == PROP_ACQUIRE) {
 			struct resource_schedule *rs;
 			assert(nr_tokens == 4);
 
@@ -216,10 +261,13 @@ static int __load_script(char * const filename)
 			list_add_tail(&rs->list, &p->__resources_to_acquire);
 		} else {
 			fprintf(stderr, "Unknown property %s\n", tokens[0]);
+			fclose(file);
+			tok_intern_fini(&__atoms);
 			return false;
 		}
 	}
 	fclose(file);
+	tok_intern_fini(&__atoms);
 	if (!quiet) printf("\n");
 	return true;
 }
@@ -39,6 +39,9 @@
  *    tokens[3] = "/path/to/dest"
  *    tokens[>=4] = NULL
  *
+ *  A token starting with '#' comments out the rest of the line.
+ *
+ *  The tokens are split by the engines in libtoken in place; see tokenizer.h.
  *
  * RETURN VALUE
  *  Return 1 if @nr_tokens > 0
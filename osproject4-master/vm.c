@@ -27,6 +27,7 @@
 
 #include "list_head.h"
 #include "vm.h"
+#include "tokenizer.h"
 
 static bool verbose = true;
 
@@ -271,10 +272,54 @@ static void __print_help(void)
 	printf("\n");
 }
 
-static bool strmatch(char * const str, const char *expect)
+enum command {
+	CMD_EXIT,
+	CMD_SHOW,
+	CMD_PAGES,
+	CMD_HELP,
+	CMD_SWITCH,
+	CMD_FREE,
+	CMD_READ,
+	CMD_WRITE,
+	CMD_ALLOC,
+	CMD_ACCESS,
+	CMD_UNKNOWN,
+};
+
+/**
+ * Command names including the aliases. They are interned first in this
+ * order, so the ID of an atom indexes this table, and the commands are
+ * matched without comparing the strings.
+ */
+static const struct {
+	const char *name;
+	enum command command;
+} __commands[] = {
+	{ "exit", CMD_EXIT },
+	{ "show", CMD_SHOW },
+	{ "pages", CMD_PAGES },
+	{ "help", CMD_HELP },
+	{ "?", CMD_HELP },
+	{ "switch", CMD_SWITCH },
+	{ "s", CMD_SWITCH },
+	{ "free", CMD_FREE },
+	{ "f", CMD_FREE },
+	{ "read", CMD_READ },
+	{ "r", CMD_READ },
+	{ "write", CMD_WRITE },
+	{ "w", CMD_WRITE },
+	{ "alloc", CMD_ALLOC },
+	{ "a", CMD_ALLOC },
+	{ "access", CMD_ACCESS },
+};
+
+static struct tok_intern __atoms;
+
+static enum command __lookup_command(char * const token)
 {
-	return (strlen(str) == strlen(expect)) &&
-			(strncmp(str, expect, strlen(expect)) == 0);
+	const struct tok_atom *atom = tok_intern_find(&__atoms, token, strlen(token));
+
+	return atom ? __commands[atom->id].command : CMD_UNKNOWN;
 }
 
 static void __do_simulation(FILE *input)
@@ -283,9 +328,15 @@ static void __do_simulation(FILE *input)
 
 	__init_system();
 
+	if (tok_intern_init(&__atoms)) return;
+	for (int i = 0; i < sizeof(__commands) / sizeof(__commands[0]); i++) {
+		tok_intern(&__atoms, __commands[i].name, strlen(__commands[i].name));
+	}
+
 	while (fgets(command, sizeof(command), input)) {
 		char *tokens[MAX_NR_TOKENS] = { NULL };
 		int nr_tokens = 0;
+		enum command cmd;
 
 		/* Make the command lowercase */
 		for (size_t i = 0; i < strlen(command); i++) {
@@ -297,13 +348,15 @@ static void __do_simulation(FILE *input)
 		}
 		if (nr_tokens == 0) continue;
 
+		cmd = __lookup_command(tokens[0]);
+
 		if (nr_tokens == 1) {
-			if (strmatch(tokens[0], "exit")) break;
-			if (strmatch(tokens[0], "show")) {
+			if (cmd == CMD_EXIT) break;
+			if (cmd == CMD_SHOW) {
 				__show_pagetable();
-			} else if (strmatch(tokens[0], "pages")) {
+			} else if (cmd == CMD_PAGES) {
 				__show_pageframes();
-			} else if (strmatch(tokens[0], "help") || strmatch(tokens[0], "?")) {
+			} else if (cmd == CMD_HELP) {
 				__print_help();
 			} else {
 				printf("Unknown command %s\n", tokens[0]);
@@ -311,13 +364,13 @@ static void __do_simulation(FILE *input)
 		} else if (nr_tokens == 2) {
 			unsigned int arg = strtoimax(tokens[1], NULL, 0);
 
-			if (strmatch(tokens[0], "switch") || strmatch(tokens[0], "s")) {
+			if (cmd == CMD_SWITCH) {
 				switch_process(arg);
-			} else if (strmatch(tokens[0], "free") || strmatch(tokens[0], "f")) {
+			} else if (cmd == CMD_FREE) {
 				__free_page(arg);
-			} else if (strmatch(tokens[0], "read") || strmatch(tokens[0], "r")) {
+			} else if (cmd == CMD_READ) {
 				__access_memory(arg, RW_READ);
-			} else if (strmatch(tokens[0], "write") || strmatch(tokens[0], "w")) {
+			} else if (cmd == CMD_WRITE) {
 				__access_memory(arg, RW_WRITE);
 			} else {
 				printf("Unknown command %s\n", tokens[0]);
@@ -326,9 +379,9 @@ static void __do_simulation(FILE *input)
 			unsigned int vpn = strtoimax(tokens[1], NULL, 0);
 			unsigned int rw = __make_rwflag(tokens[2]);
 
-			if (strmatch(tokens[0], "alloc") || strmatch(tokens[0], "a")) {
+			if (cmd == CMD_ALLOC) {
 				if (!__alloc_page(vpn, rw)) break;
-			} else if (strmatch(tokens[0], "access")) {
+			} else if (cmd == CMD_ACCESS) {
 				__access_memory(vpn, rw);
 			} else {
 				printf("Unknown command %s\n", tokens[0]);
@@ -339,6 +392,8 @@ static void __do_simulation(FILE *input)
 
 		if (verbose) printf(">> ");
 	}
+
+	tok_intern_fini(&__atoms);
 }
 
 static void __print_usage(const char * name)